@@ -3,8 +3,8 @@ background.lua:
 geração e animação do campo de estrelas. inicializarEstrelas(n) cria a tabela
 com posições e propriedades usando um LCG com seed fixa.
 obterPosicoesEstrelas recalcula posição e cor para o instante t e
-devolve uma tabela flat com cinco valores por estrela que o C++
-lê diretamente para glVertex2f e glColor3f.
+escreve cinco valores por estrela no buffer que o C++ passa como userdata,
+o mesmo vetor que o renderizador lê para glVertex2f e glColor3f.
 ]]
 
 local estrelas = {}
@@ -41,16 +41,19 @@ calcula posição e cor de todas as estrelas para o instante t. Cada estrela
 deriva para baixo em loop, oscila horizontalmente com seno e rotaciona ao
 redor do centro da tela a cada 120 segundos. O brilho cintila com seno
 individual por estrela.
+saida é o buffer do C++: saida:estrela(i, x, y, r, g, b) grava a estrela i,
+de 1 a #saida. Sem ele uma tabela nova é criada e devolvida.
 ]]
-function obterPosicoesEstrelas(tempo)
+function obterPosicoesEstrelas(tempo, saida)
     local angulo = tempo * (TWO_PI / 120.0)
     local cossenoAngulo  = math.cos(angulo)
     local senoAngulo  = math.sin(angulo)
 
-    local resultado = {}
+    local resultado = saida or {}
     local indice = 0
+    local escrever = saida and saida.estrela
 
-    for _, estrela in ipairs(estrelas) do
+    for i, estrela in ipairs(estrelas) do
         local yDerivado = estrela.y - (tempo * estrela.velocidade) % 1.0
         if yDerivado < 0.0 then yDerivado = yDerivado + 1.0 end
 
@@ -68,17 +71,25 @@ function obterPosicoesEstrelas(tempo)
         local cintilacao = 0.35 + 0.65 * (0.5 + 0.5 * math.sin(tempo * 2.0 + estrela.cintilar))
         local brilhoFinal  = estrela.brilho * cintilacao
 
-        resultado[indice + 1] = rotacionadoX
-        resultado[indice + 2] = rotacionadoY
-        resultado[indice + 3] = brilhoFinal * 0.85
-        resultado[indice + 4] = brilhoFinal * 0.90
-        resultado[indice + 5] = brilhoFinal
-        indice = indice + 5
+        if escrever then
+            escrever(saida, i, rotacionadoX, rotacionadoY,
+                     brilhoFinal * 0.85, brilhoFinal * 0.90, brilhoFinal)
+        else
+            resultado[indice + 1] = rotacionadoX
+            resultado[indice + 2] = rotacionadoY
+            resultado[indice + 3] = brilhoFinal * 0.85
+            resultado[indice + 4] = brilhoFinal * 0.90
+            resultado[indice + 5] = brilhoFinal
+            indice = indice + 5
+        end
     end
 
     return resultado
 end
 
-local bgState = { colorIndex = 0, model = 1 }
+-- global pelo mesmo motivo do estadoFaces em faces.lua; as estrelas não
+-- precisam: a ponte as gera de novo, iguais, depois de uma recarga
+estadoBackground = estadoBackground or { colorIndex = 0, model = 1 }
+local bgState = estadoBackground
 function getBackgroundState() return bgState.colorIndex, bgState.model end
 function setBackgroundState(i, m) bgState.colorIndex = i; bgState.model = m end
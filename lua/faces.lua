@@ -1,14 +1,17 @@
 --[[
   faces.lua
 Mantém o estado das seis faces do cubo no lado Lua: por enquanto só o caminho
-da foto carregada em cada face. resolverFacePicking converte o byte R lido pelo
-glReadPixels no índice da face clicada.
+da foto carregada em cada face. resolverFacePicking converte o identificador
+devolvido pelo picking por raio no índice da face clicada.
 ]]
 
-local faces = {}
+-- o estado fica numa global para sobreviver quando o script é recarregado
+-- com o programa rodando (CUBO_LUA_DIR)
+estadoFaces = estadoFaces or {}
+local faces = estadoFaces
 
 for i = 0, 5 do
-    faces[i] = {
+    faces[i] = faces[i] or {
         caminhoFoto = nil
     }
 end
@@ -20,13 +23,13 @@ local function limitarIndice(indice)
 end
 
 --[[
-o cubo renderiza cada face com glColor3ub durante o picking,
-então o canal R lido vale 1–6 para as faces 0–5 e 0 para o fundo.
+o picking por raio numera as faces 0–5 como 1–6 e devolve 0 quando o
+raio passa fora do cubo.
 Retorna o índice da face ou -1 se o clique não acertou nenhuma.
 ]]
-function resolverFacePicking(valorPixelR)
-    if valorPixelR >= 1 and valorPixelR <= 6 then
-        return valorPixelR - 1
+function resolverFacePicking(idPicking)
+    if idPicking >= 1 and idPicking <= 6 then
+        return idPicking - 1
     end
     return -1
 end
@@ -3,8 +3,15 @@
 
   Textos do painel de controles. Manter aqui evita strings hardcoded no C++ e
   permite ajustar mensagens e cores sem recompilar.
+
+  O C++ desenha o painel uma vez e guarda o desenho; obterLinhasControles só
+  é chamada de novo quando a versão das linhas muda. Carregar este script
+  já avisa. Se as linhas passarem a mudar com o programa rodando, chame
+  avisarControlesAlterados() de novo a cada mudança.
 ]]
 
+avisarControlesAlterados()
+
 function obterLinhasControles()
     return {
         { texto = "WASD: rodar cubo", r = 0.85, g = 0.85, b = 0.88, passo = 16 },
@@ -15,6 +22,7 @@ function obterLinhasControles()
         { texto = "Seta esq/dir: girar imagem", r = 0.85, g = 0.85, b = 0.88, passo = 16 },
         { texto = "Seta Cima/Baixo: zoom imagem", r = 0.85, g = 0.85, b = 0.88, passo = 16 },
         { texto = "R: resetar face", r = 0.85, g = 0.85, b = 0.88, passo = 16 },
+        { texto = "E: estrelas Lua / C++ / GPU", r = 0.85, g = 0.85, b = 0.88, passo = 16 },
         { texto = "ESC: sair", r = 0.85, g = 0.85, b = 0.88, passo = 16 },
     }
 end
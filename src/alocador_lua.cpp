@@ -0,0 +1,112 @@
+/*
+ * alocador_lua.cpp
+ *
+ * Listas livres por classe de tamanho sobre blocos de TAMANHO_BLOCO bytes.
+ * Um bloco novo é cortado aos poucos: cada pedido sem bloco livre na sua
+ * classe avança o cursor do bloco atual. O resto que não cabe mais nenhuma
+ * classe fica sem uso até o fim, no máximo MAIOR_CLASSE bytes por bloco.
+ */
+
+#include "alocador_lua.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+AlocadorLua::~AlocadorLua() {
+    for (void* b : blocos) std::free(b);
+}
+
+void* AlocadorLua::funcao(void* ud, void* ptr, size_t osize, size_t nsize) {
+    // com ptr nulo o Lua passa o tipo do objeto em osize, não um tamanho
+    return static_cast<AlocadorLua*>(ud)->realocar(ptr, ptr ? osize : 0, nsize);
+}
+
+void* AlocadorLua::pegar(int classe) {
+    if (Livre* l = livres[classe]) {
+        livres[classe] = l->proximo;
+        return l;
+    }
+    size_t tamanho = (size_t)(classe + 1) * GRANULO;
+    if (restante < tamanho) {
+        char* bloco = static_cast<char*>(std::malloc(TAMANHO_BLOCO));
+        if (!bloco) return nullptr;
+        blocos.push_back(bloco);
+        est.bytesReservados += TAMANHO_BLOCO;
+        cursor   = bloco;
+        restante = TAMANHO_BLOCO;
+    }
+    void* p = cursor;
+    cursor   += tamanho;
+    restante -= tamanho;
+    return p;
+}
+
+void AlocadorLua::devolver(void* p, int classe) {
+    Livre* l = static_cast<Livre*>(p);
+    l->proximo = livres[classe];
+    livres[classe] = l;
+}
+
+void* AlocadorLua::novo(size_t tamanho) {
+    if (tamanho > MAIOR_CLASSE) return std::malloc(tamanho);
+    void* p = pegar(classeDe(tamanho));
+    if (p) ++est.doPool;
+    return p;
+}
+
+void AlocadorLua::soltar(void* p, size_t tamanho) {
+    if (tamanho > MAIOR_CLASSE) std::free(p);
+    else                        devolver(p, classeDe(tamanho));
+}
+
+/*
+ * Mesma classe: o bloco já serve. Dois tamanhos grandes: realloc. Mudou de
+ * classe ou cruzou o limite entre pool e malloc: aloca, copia e solta.
+ */
+void* AlocadorLua::realocar(void* ptr, size_t osize, size_t nsize) {
+    if (nsize == 0) {
+        if (ptr) {
+            soltar(ptr, osize);
+            est.bytesVivos -= osize;
+            ++est.liberacoes;
+        }
+        return nullptr;
+    }
+
+    if (nsize > osize && est.limite && est.bytesVivos + (nsize - osize) > est.limite) {
+        ++est.falhas;
+        return nullptr;
+    }
+
+    void* r;
+    if (!ptr) {
+        r = novo(nsize);
+        if (!r) { ++est.falhas; return nullptr; }
+        ++est.alocacoes;
+    } else {
+        bool pequenoAntes  = osize <= MAIOR_CLASSE;
+        bool pequenoDepois = nsize <= MAIOR_CLASSE;
+        if (pequenoAntes && pequenoDepois && classeDe(osize) == classeDe(nsize)) {
+            r = ptr;
+        } else if (!pequenoAntes && !pequenoDepois) {
+            r = std::realloc(ptr, nsize);
+        } else {
+            r = novo(nsize);
+            if (r) {
+                std::memcpy(r, ptr, std::min(osize, nsize));
+                soltar(ptr, osize);
+            }
+        }
+        if (!r) {
+            // encolher não pode falhar: o bloco antigo continua servindo
+            if (nsize <= osize) r = ptr;
+            else { ++est.falhas; return nullptr; }
+        }
+        ++est.realocacoes;
+    }
+
+    if (nsize > osize) est.bytesAlocados += nsize - osize;
+    est.bytesVivos = est.bytesVivos - osize + nsize;
+    est.picoBytes  = std::max(est.picoBytes, est.bytesVivos);
+    return r;
+}
@@ -0,0 +1,80 @@
+/*
+ * alocador_lua.h
+ *
+ * Alocador do lua_State da ponte. Quase tudo que o Lua aloca é pequeno e
+ * vive pouco: strings curtas, nós de table, closures, a table de estrelas
+ * refeita a cada frame. Pedidos de até MAIOR_CLASSE bytes são arredondados
+ * para classes de GRANULO bytes e servidos de listas livres por classe,
+ * cortadas de blocos grandes; o que passa disso vai para malloc/realloc.
+ * Os blocos só voltam ao sistema quando o alocador é destruído, depois do
+ * lua_close.
+ *
+ * Com um limite definido, um pedido que faria os bytes vivos passarem dele
+ * devolve NULL e o Lua levanta um erro de memória, que a ponte trata como
+ * qualquer outro erro de pcall. Encolher nunca falha, como o Lua exige.
+ *
+ * Um alocador atende um único lua_State e não tem trava.
+ */
+
+#ifndef ALOCADOR_LUA_H
+#define ALOCADOR_LUA_H
+
+#include <cstddef>
+#include <vector>
+
+struct EstatisticasMemoriaLua {
+    size_t bytesVivos;
+    size_t picoBytes;
+    size_t bytesReservados;
+    size_t limite;
+    unsigned long long bytesAlocados;
+    unsigned long long alocacoes;
+    unsigned long long liberacoes;
+    unsigned long long realocacoes;
+    unsigned long long doPool;
+    unsigned long long falhas;
+};
+
+class AlocadorLua {
+public:
+    static constexpr size_t GRANULO       = 16;
+    static constexpr int    CLASSES       = 16;
+    static constexpr size_t MAIOR_CLASSE  = GRANULO * CLASSES;
+    static constexpr size_t TAMANHO_BLOCO = 64 * 1024;
+
+    AlocadorLua() = default;
+    ~AlocadorLua();
+    AlocadorLua(const AlocadorLua&) = delete;
+    AlocadorLua& operator=(const AlocadorLua&) = delete;
+
+    /*
+     * Função no formato lua_Alloc; 'ud' é o AlocadorLua.
+     */
+    static void* funcao(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    /*
+     * Teto para os bytes vivos; 0 desliga o limite.
+     */
+    void definirLimite(size_t bytes) { est.limite = bytes; }
+
+    const EstatisticasMemoriaLua& estatisticas() const { return est; }
+
+private:
+    struct Livre { Livre* proximo; };
+
+    Livre* livres[CLASSES] = {};
+    char*  cursor   = nullptr;
+    size_t restante = 0;
+    std::vector<void*> blocos;
+    EstatisticasMemoriaLua est = {};
+
+    static int classeDe(size_t tamanho) { return (int)((tamanho + GRANULO - 1) / GRANULO) - 1; }
+
+    void* realocar(void* ptr, size_t osize, size_t nsize);
+    void* pegar(int classe);
+    void  devolver(void* p, int classe);
+    void* novo(size_t tamanho);
+    void  soltar(void* p, size_t tamanho);
+};
+
+#endif
@@ -2,32 +2,188 @@
  * background.cpp
  *
  * Renderiza o fundo estrelado. O quad escuro de fundo é desenhado direto em
- * OpenGL aqui; as estrelas vêm do background.lua, que retorna
- * uma tabela flat com x, y, r, g, b por estrela. O C++ só itera esse vetor e
- * chama glVertex2f/glColor3f fazendo com que nenhuma matemática de animação aconteça aqui.
+ * OpenGL aqui. Nos motores de CPU as estrelas vêm do background.lua (ou do
+ * CampoEstrelas), que escreve x, y, r, g, b por estrela em cacheEstrelas; o
+ * vetor é desenhado de uma vez com vertex arrays e glDrawArrays.
+ *
+ * No motor de GPU o VBO guarda só as constantes de cada estrela e o vertex
+ * shader abaixo repete a conta de obterPosicoesEstrelas para o uniform
+ * 'tempo'. Não há trabalho por estrela na CPU nem chamada Lua por frame.
+ *
+ * Com a simulação assíncrona os motores de CPU só pedem o quadro do
+ * instante atual e desenham o último que ficou pronto.
  */
 
 #include "background.h"
 #include "lua_bridge.h"
+#include "relogio.h"
+#include "shader.h"
+#include "simulacao_estrelas.h"
+#include "trace.h"
 #include <GL/glut.h>
+#include <iostream>
+
+namespace {
+
+/*
+ * gl_Vertex.xy traz x, y e gl_MultiTexCoord0.xyz traz velocidade, brilho e
+ * fase de cintilação, na ordem de CampoEstrelas::copiarConstantes.
+ */
+const char* VERTEX_ESTRELAS = R"(
+#version 120
+uniform float tempo;
+
+void main() {
+    float velocidade = gl_MultiTexCoord0.x;
+    float brilho     = gl_MultiTexCoord0.y;
+    float cintilar   = gl_MultiTexCoord0.z;
 
-#ifdef BENCH_MODE
-#include "bench.h"
-#endif
+    float yDerivado = gl_Vertex.y - fract(tempo * velocidade);
+    if (yDerivado < 0.0) yDerivado += 1.0;
+    float xDerivado = gl_Vertex.x + sin(tempo * 0.15 + cintilar) * 0.01;
+
+    float angulo = tempo * (6.28318530718 / 120.0);
+    float c = cos(angulo);
+    float s = sin(angulo);
+    vec2 relativo = vec2(xDerivado, yDerivado) - 0.5;
+    vec2 rotacionado = vec2(relativo.x * c - relativo.y * s,
+                            relativo.x * s + relativo.y * c) + 0.5;
+    rotacionado -= floor(rotacionado);
+
+    float cintilacao = 0.35 + 0.65 * (0.5 + 0.5 * sin(tempo * 2.0 + cintilar));
+    float brilhoFinal = brilho * cintilacao;
+
+    gl_FrontColor = vec4(brilhoFinal * 0.85, brilhoFinal * 0.90, brilhoFinal, 1.0);
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(rotacionado, 0.0, 1.0);
+}
+)";
+
+const char* FRAGMENT_ESTRELAS = R"(
+#version 120
+void main() {
+    gl_FragColor = gl_Color;
+}
+)";
+
+}
 
 Background::Background(LuaBridge* b)
-    : ponteiroBridge(b) {}
+    : ponteiroBridge(b), ponteiroRelogio(nullptr), simulacao(nullptr), motor(MotorEstrelas::Lua),
+      vboEstrelas(0), programaEstrelas(0), uniformTempo(-1),
+      vboDesatualizado(true), gpuIndisponivel(false) {}
 
 void Background::definirPadrao() {
 }
 
+/*
+ * Gera as estrelas em todos os motores com a mesma quantidade, para que a
+ * troca entre eles não mude o campo na tela. O VBO do motor de GPU é
+ * reenviado no próximo frame desenhado por ele.
+ */
+void Background::inicializarEstrelas(int quantidade) {
+    if (ponteiroBridge) {
+        ponteiroBridge->inicializarEstrelas(quantidade);
+    }
+    campoNativo.inicializar(quantidade);
+    if (simulacao) simulacao->inicializarEstrelas(quantidade);
+    vboDesatualizado = true;
+}
+
+/*
+ * Cicla Lua → C++ → GPU. Se o shader não compilou nesta máquina o motor de
+ * GPU é pulado.
+ */
+void Background::alternarMotor() {
+    if (motor == MotorEstrelas::Lua)
+        motor = MotorEstrelas::Nativo;
+    else if (motor == MotorEstrelas::Nativo && !gpuIndisponivel)
+        motor = MotorEstrelas::GPU;
+    else
+        motor = MotorEstrelas::Lua;
+
+    if (motor == MotorEstrelas::Nativo)
+        std::cout << "Motor das estrelas: C++ (" << CampoEstrelas::caminhoSimd() << ")" << std::endl;
+    else if (motor == MotorEstrelas::GPU)
+        std::cout << "Motor das estrelas: GPU (vertex shader)" << std::endl;
+    else
+        std::cout << "Motor das estrelas: Lua" << std::endl;
+}
+
+/*
+ * Compila o programa na primeira vez e reenvia as constantes das estrelas
+ * quando elas mudaram. O VBO é GL_STATIC_DRAW: depois do envio nada mais é
+ * escrito nele. Retorna false se o shader não puder ser usado.
+ */
+bool Background::prepararGpu() {
+    if (gpuIndisponivel) return false;
+    if (!programaEstrelas) {
+        programaEstrelas = compilarPrograma("estrelas", VERTEX_ESTRELAS, FRAGMENT_ESTRELAS);
+        if (!programaEstrelas) {
+            gpuIndisponivel = true;
+            return false;
+        }
+        uniformTempo = glGetUniformLocation(programaEstrelas, "tempo");
+        glGenBuffers(1, &vboEstrelas);
+    }
+    if (vboDesatualizado) {
+        std::vector<float> constantes;
+        campoNativo.copiarConstantes(constantes);
+        glBindBuffer(GL_ARRAY_BUFFER, vboEstrelas);
+        glBufferData(GL_ARRAY_BUFFER, constantes.size() * sizeof(float),
+                     constantes.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        vboDesatualizado = false;
+    }
+    return true;
+}
+
+void Background::desenharEstrelasGpu(float t) {
+    const GLsizei stride = 5 * sizeof(float);
+    glUseProgram(programaEstrelas);
+    glUniform1f(uniformTempo, t);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vboEstrelas);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, stride, (const void*)0);
+    glTexCoordPointer(3, GL_FLOAT, stride, (const void*)(2 * sizeof(float)));
+
+    glPointSize(1.6f);
+    glDrawArrays(GL_POINTS, 0, campoNativo.quantidade());
+
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+}
+
+/*
+ * Desenha as estrelas direto da memória com vertex arrays: posição nos
+ * dois primeiros floats de cada pacote e cor nos três seguintes.
+ */
+void Background::desenharEstrelasCpu(const std::vector<float>& estrelas) {
+    if (estrelas.size() < 5) return;
+    const GLsizei stride = 5 * sizeof(float);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, stride, estrelas.data());
+    glColorPointer(3, GL_FLOAT, stride, estrelas.data() + 2);
+
+    glPointSize(1.6f);
+    glDrawArrays(GL_POINTS, 0, (GLsizei)(estrelas.size() / 5));
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
 /*
  * Configura projeção 2D ortogonal, desenha o quad de fundo e então
- * delega ao Lua o cálculo das posições das estrelas para o tempo atual.
- * Em BENCH_MODE a chamada Lua é isolada dos timers de C++ para medir
- * separadamente no painel de benchmark.
+ * calcula as posições das estrelas para o tempo atual no motor escolhido.
+ * No bench o passe inteiro conta como Render (o ScopedTimer em main.cpp),
+ * e obterPosicoesEstrelas conta também como Lua pelo ScopedTimer da ponte.
  */
 void Background::renderizar() {
+    TRACE_SCOPE("Background::renderizar");
     glDisable(GL_DEPTH_TEST);
     glMatrixMode(GL_PROJECTION);
     glPushMatrix();
@@ -43,24 +199,32 @@ void Background::renderizar() {
     glVertex2f(1, 1); glVertex2f(0, 1);
     glEnd();
 
-    if (ponteiroBridge) {
-        float t = glutGet(GLUT_ELAPSED_TIME) / 1000.0f;
+    float t = ponteiroRelogio ? (float)ponteiroRelogio->agora() : 0.0f;
 
-#ifdef BENCH_MODE
-        gBench.luaBegin();
-#endif
-        ponteiroBridge->obterPosicoesEstrelas(t, cacheEstrelas);
-#ifdef BENCH_MODE
-        gBench.luaEnd();
-#endif
-
-        glPointSize(1.6f);
-        glBegin(GL_POINTS);
-        for (size_t i = 0; i + 4 < cacheEstrelas.size(); i += 5) {
-            glColor3f(cacheEstrelas[i+2], cacheEstrelas[i+3], cacheEstrelas[i+4]);
-            glVertex2f(cacheEstrelas[i+0], cacheEstrelas[i+1]);
+    if (motor == MotorEstrelas::GPU && !prepararGpu()) {
+        std::cerr << "Motor de GPU indisponível, usando C++" << std::endl;
+        motor = MotorEstrelas::Nativo;
+    }
+
+    if (motor == MotorEstrelas::GPU) {
+        TRACE_SCOPE("estrelas GPU");
+        desenharEstrelasGpu(t);
+    } else if (simulacao) {
+        simulacao->pedir(t, motor);
+        const QuadroEstrelas* quadro = simulacao->ultimoQuadro();
+        TRACE_SCOPE("estrelas desenho");
+        if (quadro) desenharEstrelasCpu(quadro->vertices);
+    } else if (motor == MotorEstrelas::Nativo) {
+        {
+            TRACE_SCOPE("CampoEstrelas::calcular");
+            campoNativo.calcular(t, cacheEstrelas);
         }
-        glEnd();
+        TRACE_SCOPE("estrelas desenho");
+        desenharEstrelasCpu(cacheEstrelas);
+    } else if (ponteiroBridge) {
+        ponteiroBridge->obterPosicoesEstrelas(t, cacheEstrelas);
+        TRACE_SCOPE("estrelas desenho");
+        desenharEstrelasCpu(cacheEstrelas);
     }
 
     glMatrixMode(GL_PROJECTION);
@@ -1,28 +1,71 @@
 /*
  * background.h
  *
- * A lógica das estrelas vive inteiramente em background.lua — posição, velocidade,
+ * A lógica das estrelas vive em background.lua — posição, velocidade,
  * cintilamento. Background::renderizar() pede ao Lua as posições para o instante
- * atual e desenha os pontos com GL_POINTS. Sem nenhuma matemática de partícula
- * em C++, só o desenho OpenGL.
+ * atual e desenha os pontos com GL_POINTS.
+ *
+ * Para campos muito grandes há também o motor nativo (CampoEstrelas), que
+ * reproduz a mesma conta em C++ com SIMD, e o motor de GPU, que envia as
+ * constantes de cada estrela uma vez para um VBO e faz a animação inteira
+ * no vertex shader a partir de um uniform de tempo. O motor pode ser trocado
+ * em tempo de execução. O make check confere que Lua e C++ dão as mesmas
+ * estrelas a menos de 2e-5, fora as que caem na borda do wrap de y; o motor
+ * de GPU usa as mesmas constantes, mas não é conferido.
+ *
+ * O instante da animação vem do Relogio da cena, não do relógio de parede,
+ * para que um passo fixo reproduza os mesmos frames.
+ *
+ * Com uma SimulacaoEstrelas ligada, os motores de CPU calculam numa thread
+ * própria e aqui só se desenha o último quadro que ela terminou.
  */
 
 #ifndef BACKGROUND_H
 #define BACKGROUND_H
 
+#include <GL/glut.h>
 #include <vector>
+#include "estrelas_nativo.h"
 
 class LuaBridge;
+class Relogio;
+class SimulacaoEstrelas;
+
+enum class MotorEstrelas {
+    Lua,
+    Nativo,
+    GPU
+};
 
 class Background {
 private:
     LuaBridge*  ponteiroBridge;
+    const Relogio* ponteiroRelogio;
+    SimulacaoEstrelas* simulacao;
     std::vector<float> cacheEstrelas;
+    CampoEstrelas campoNativo;
+    MotorEstrelas motor;
+
+    GLuint vboEstrelas;
+    GLuint programaEstrelas;
+    GLint  uniformTempo;
+    bool   vboDesatualizado;
+    bool   gpuIndisponivel;
+
+    bool prepararGpu();
+    void desenharEstrelasGpu(float t);
+    void desenharEstrelasCpu(const std::vector<float>& estrelas);
 
 public:
     explicit Background(LuaBridge* b = nullptr);
     void definirPadrao();
     void definirBridge(LuaBridge* b) { ponteiroBridge = b; }
+    void definirRelogio(const Relogio* r) { ponteiroRelogio = r; }
+    void definirSimulacao(SimulacaoEstrelas* s) { simulacao = s; }
+    void inicializarEstrelas(int quantidade);
+    void definirMotor(MotorEstrelas m) { motor = m; }
+    MotorEstrelas obterMotor() const { return motor; }
+    void alternarMotor();
     void renderizar();
 };
 
@@ -3,32 +3,37 @@
  *
  * Implementação do BenchMonitor. Medições com std::chrono::high_resolution_clock,
  * RSS lida de /proc/self/status no Linux, painel renderizado em OpenGL imediato.
+ * As séries ficam num anel fixo com somas corridas e histogramas logarítmicos.
  */
 
 #ifdef BENCH_MODE
 
 #include "bench.h"
+#include "bench_scope.h"
 #include <GL/glut.h>
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
+#include <iostream>
 #include <sstream>
 #include <string>
 #include <numeric>
 
 BenchMonitor gBench;
 
+// marca a thread que abre os frames; as outras não somam no frame
+static thread_local bool tFrameThread = false;
+
 static double toMs(BenchTP a, BenchTP b) {
     return std::chrono::duration<double, std::milli>(b - a).count();
 }
-static double toUs(BenchTP a, BenchTP b) {
-    return std::chrono::duration<double, std::micro>(b - a).count();
-}
 
 void BenchMonitor::frameBegin() {
     frameStart   = BenchClock::now();
-    luaAccumUs  = 0.0;
-    cppAccumUs  = 0.0;
+    tFrameThread = true;
+    for (auto& ns : categoryNs) ns.store(0, std::memory_order_relaxed);
 
     if (!timerInit) {
         fpsTimer  = frameStart;
@@ -37,12 +42,16 @@ void BenchMonitor::frameBegin() {
 }
 
 void BenchMonitor::frameEnd() {
+    gpuFrame = (gpuFrame + 1) % GPU_FRAMES;
+
     auto now    = BenchClock::now();
     float fms   = (float)toMs(frameStart, now);
-    float lus   = (float)luaAccumUs;
-    float cus   = (float)cppAccumUs;
+    float lus   = categoryNs[bench::Lua::index].load(std::memory_order_relaxed)    / 1000.0f;
+    float cus   = categoryNs[bench::Render::index].load(std::memory_order_relaxed) / 1000.0f;
+    float gus   = categoryNs[bench::GC::index].load(std::memory_order_relaxed)     / 1000.0f;
+    float wus   = workerNs.exchange(0, std::memory_order_relaxed) / 1000.0f;
 
-    pushSnap(fms, lus, cus);
+    pushSnap(fms, lus, cus, gus, wus);
 
     frameCount++;
     fpsAccumMs += fms;
@@ -53,30 +62,220 @@ void BenchMonitor::frameEnd() {
     }
 }
 
-void BenchMonitor::luaBegin()         { luaStart = BenchClock::now(); }
-void BenchMonitor::luaEnd()           { luaAccumUs += toUs(luaStart, BenchClock::now()); }
+static_assert(bench::CATEGORY_COUNT == 3, "BenchMonitor::CATEGORIES desatualizado");
+
+void BenchMonitor::addCategoryTime(int category, BenchClock::duration elapsed) {
+    if (category < 0 || category >= CATEGORIES) return;
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    if (tFrameThread) categoryNs[category].fetch_add(ns, std::memory_order_relaxed);
+    else              workerNs.fetch_add(ns, std::memory_order_relaxed);
+}
+
+/*
+ * Confere uma vez se o driver devolve mesmo uma duração: mede um
+ * GL_TIME_ELAPSED vazio entre duas leituras de GL_TIMESTAMP, com glFinish
+ * antes da segunda. Uma duração de verdade cabe nessa janela; um driver
+ * que devolve outra coisa (um timestamp absoluto, lixo) não cabe.
+ */
+static bool elapsedQueryIsSane(GLuint q) {
+    GLint64 before = 0, after = 0;
+    glGetInteger64v(GL_TIMESTAMP, &before);
+    glBeginQuery(GL_TIME_ELAPSED, q);
+    glEndQuery(GL_TIME_ELAPSED);
+    glFinish();
+    glGetInteger64v(GL_TIMESTAMP, &after);
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(q, GL_QUERY_RESULT, &ns);
+    return glGetError() == GL_NO_ERROR && after >= before && ns <= (GLuint64)(after - before);
+}
+
+/*
+ * GL_TIME_ELAPSED é núcleo no GL 3.3; antes disso depende da extensão.
+ * A checagem é feita uma vez, já com o contexto atual, e inclui um teste
+ * do resultado contra GL_TIMESTAMP.
+ */
+bool BenchMonitor::gpuAvailable() {
+    if (gpuSupport < 0) {
+        GLint major = 0, minor = 0;
+        const char* ver = (const char*)glGetString(GL_VERSION);
+        if (ver) sscanf(ver, "%d.%d", &major, &minor);
+        const char* ext = (const char*)glGetString(GL_EXTENSIONS);
+        bool core = major > 3 || (major == 3 && minor >= 3);
+        gpuSupport = (core || (ext && strstr(ext, "GL_ARB_timer_query"))) ? 1 : 0;
+        if (gpuSupport) {
+            while (glGetError() != GL_NO_ERROR) {}
+            glGenQueries(GPU_FRAMES * GPU_PASS_COUNT, &gpuQueries[0][0]);
+            if (!elapsedQueryIsSane(gpuQueries[0][0])) {
+                std::cerr << "Bench: GL_TIME_ELAPSED não bate com GL_TIMESTAMP; tempo de GPU desligado" << std::endl;
+                glDeleteQueries(GPU_FRAMES * GPU_PASS_COUNT, &gpuQueries[0][0]);
+                gpuSupport = 0;
+            }
+        }
+    }
+    return gpuSupport == 1;
+}
+
+void BenchMonitor::gpuBegin(GpuPass pass) {
+    gpuActive = -1;
+    if (!gpuAvailable()) return;
+
+    GLuint q = gpuQueries[gpuFrame][pass];
+    if (gpuPending[gpuFrame][pass]) {
+        GLint ready = 0;
+        glGetQueryObjectiv(q, GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready) return;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(q, GL_QUERY_RESULT, &ns);
+        gpuPending[gpuFrame][pass] = false;
+        gpuPushSample(pass, (float)(ns / 1000.0));
+    }
+    glBeginQuery(GL_TIME_ELAPSED, q);
+    gpuActive = pass;
+}
+
+void BenchMonitor::gpuEnd() {
+    if (gpuActive < 0) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    gpuPending[gpuFrame][gpuActive] = true;
+    gpuActive = -1;
+}
+
+void BenchMonitor::gpuPushSample(int pass, float us) {
+    if (gpuCount[pass] == HISTORY) {
+        gpuSumUs[pass] -= gpuSamples[pass][gpuHead[pass]];
+        --gpuCount[pass];
+    }
+    gpuSamples[pass][gpuHead[pass]] = us;
+    gpuSumUs[pass] += us;
+    gpuHead[pass] = (gpuHead[pass] + 1) % HISTORY;
+    ++gpuCount[pass];
+}
+
+/*
+ * Média dos últimos HISTORY resultados do passe; -1 sem timer queries.
+ */
+float BenchMonitor::getGpuUs(GpuPass pass) const {
+    if (gpuSupport == 0) return -1.0f;
+    return gpuCount[pass] ? (float)(gpuSumUs[pass] / gpuCount[pass]) : 0.0f;
+}
+
+void BenchMonitor::setClockInfo(const char* mode, double simTime, double simDelta) {
+    clockMode  = mode;
+    clockTime  = simTime;
+    clockDelta = simDelta;
+}
+
+void BenchMonitor::setTexInfo(const TexMemInfo& info) {
+    texInfo = info;
+}
+
+int LatencyHistogram::bucketOf(float us) {
+    uint32_t v = (us <= 0.0f) ? 0u : (us >= 4294967040.0f) ? 0xFFFFFFFFu : (uint32_t)us;
+    if (v < (uint32_t)SUB_COUNT) return (int)v;
+    int e = 31 - __builtin_clz(v);
+    int sub = (int)((v >> (e - SUB_BITS)) & (SUB_COUNT - 1));
+    return SUB_COUNT + (e - SUB_BITS) * SUB_COUNT + sub;
+}
+
+uint32_t LatencyHistogram::upperBound(int bucket) {
+    if (bucket < SUB_COUNT) return (uint32_t)bucket;
+    int e   = (bucket - SUB_COUNT) / SUB_COUNT + SUB_BITS;
+    int sub = (bucket - SUB_COUNT) % SUB_COUNT;
+    uint64_t top = ((uint64_t)(SUB_COUNT + sub + 1) << (e - SUB_BITS)) - 1;
+    return top > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)top;
+}
+
+float LatencyHistogram::percentile(float p) const {
+    if (total == 0) return 0.0f;
+    uint64_t rank = (uint64_t)std::ceil(p / 100.0 * total);
+    if (rank < 1) rank = 1;
+    uint64_t acc = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        acc += counts[i];
+        if (acc >= rank) return (float)upperBound(i);
+    }
+    return (float)upperBound(BUCKETS - 1);
+}
+
+/*
+ * Anel de tamanho fixo: a soma de cada série é atualizada só com o frame que
+ * entra e o que sai, e os histogramas idem. Nada é alocado por frame.
+ */
+void BenchMonitor::pushSnap(float fms, float lus, float cus, float gus, float wus) {
+    while (count >= window) dropOldest();
+
+    history[head] = {fms, lus, cus, gus, wus};
+    head = (head + 1) % MAX_HISTORY;
+    ++count;
+    sumFrameMs += fms;
+    sumLuaUs   += lus;
+    sumCppUs   += cus;
+    sumGcUs    += gus;
+    sumWorkerUs += wus;
+    histFrame.add(fms * 1000.0f);
+    histLua.add(lus);
+    histCpp.add(cus);
+    histGc.add(gus);
+    histWorker.add(wus);
+    updateAverages();
+}
 
-void BenchMonitor::cppRenderBegin()   { cppStart = BenchClock::now(); }
-void BenchMonitor::cppRenderEnd()     { cppAccumUs += toUs(cppStart, BenchClock::now()); }
+void BenchMonitor::updateAverages() {
+    int n = std::max(count, 1);
+    avgFrameMs = (float)(sumFrameMs / n);
+    avgLuaUs   = (float)(sumLuaUs / n);
+    avgCppUs   = (float)(sumCppUs / n);
+    avgGcUs    = (float)(sumGcUs / n);
+    avgWorkerUs = (float)(sumWorkerUs / n);
+}
 
-void BenchMonitor::setTexInfo(int activeCount, long estimatedKb) {
-    texCount = activeCount;
-    texKb    = estimatedKb;
+void BenchMonitor::dropOldest() {
+    if (count == 0) return;
+    const FrameSnap& old = history[(head - count + MAX_HISTORY) % MAX_HISTORY];
+    sumFrameMs -= old.frameMs;
+    sumLuaUs   -= old.luaUs;
+    sumCppUs   -= old.cppUs;
+    sumGcUs    -= old.gcUs;
+    sumWorkerUs -= old.workerUs;
+    histFrame.remove(old.frameMs * 1000.0f);
+    histLua.remove(old.luaUs);
+    histCpp.remove(old.cppUs);
+    histGc.remove(old.gcUs);
+    histWorker.remove(old.workerUs);
+    --count;
 }
 
-void BenchMonitor::pushSnap(float fms, float lus, float cus) {
-    history.push_back({fms, lus, cus});
-    if ((int)history.size() > HISTORY)
-        history.pop_front();
+void BenchMonitor::setWindow(int frames) {
+    window = std::max(1, std::min(frames, MAX_HISTORY));
+    while (count > window) dropOldest();
+    updateAverages();
+}
 
-    double sf = 0, sl = 0, sc = 0;
-    for (auto& s : history) { sf += s.frameMs; sl += s.luaUs; sc += s.cppUs; }
-    int n  = (int)history.size();
-    avgFrameMs = (float)(sf / n);
-    avgLuaUs   = (float)(sl / n);
-    avgCppUs   = (float)(sc / n);
+/*
+ * Percentis vêm do histograma (limite superior do balde); o máximo é exato,
+ * varrendo a janela. toUs converte a unidade da série para µs.
+ */
+LatencyStats BenchMonitor::stats(const LatencyHistogram& h, float FrameSnap::*field,
+                                 float mean, float toUs) const {
+    LatencyStats st = {mean, 0.0f, 0.0f, 0.0f, 0.0f};
+    if (count == 0) return st;
+    st.p50 = h.percentile(50.0f) / toUs;
+    st.p95 = h.percentile(95.0f) / toUs;
+    st.p99 = h.percentile(99.0f) / toUs;
+    for (int i = 0; i < count; ++i)
+        st.max = std::max(st.max, history[(head - 1 - i + MAX_HISTORY) % MAX_HISTORY].*field);
+    st.p50 = std::min(st.p50, st.max);
+    st.p95 = std::min(st.p95, st.max);
+    st.p99 = std::min(st.p99, st.max);
+    return st;
 }
 
+LatencyStats BenchMonitor::getFrameStats() const { return stats(histFrame, &FrameSnap::frameMs, avgFrameMs, 1000.0f); }
+LatencyStats BenchMonitor::getLuaStats()   const { return stats(histLua,   &FrameSnap::luaUs,   avgLuaUs,   1.0f); }
+LatencyStats BenchMonitor::getCppStats()   const { return stats(histCpp,   &FrameSnap::cppUs,   avgCppUs,   1.0f); }
+LatencyStats BenchMonitor::getGcStats()    const { return stats(histGc,    &FrameSnap::gcUs,    avgGcUs,    1.0f); }
+LatencyStats BenchMonitor::getWorkerStats() const { return stats(histWorker, &FrameSnap::workerUs, avgWorkerUs, 1.0f); }
+
 long BenchMonitor::getRssKb() {
 #ifdef __linux__
     std::ifstream f("/proc/self/status");
@@ -107,6 +306,41 @@ void quad(float x1, float y1, float x2, float y2) {
     glEnd();
 }
 
+const char* formatName(unsigned fmt) {
+    switch (fmt) {
+        case GL_RGB:   return "RGB";
+        case GL_RGBA:  return "RGBA";
+        case GL_RGB8:  return "RGB8";
+        case GL_RGBA8: return "RGBA8";
+    }
+    return "?";
+}
+
+/*
+ * Bytes em kB com uma casa; abaixo de 1 kB mostra os bytes.
+ */
+void formatBytes(char* out, size_t n, long long bytes) {
+    if (bytes < 1024)
+        snprintf(out, n, "%lld B", bytes);
+    else
+        snprintf(out, n, "%.1f kB", bytes / 1024.0);
+}
+
+/*
+ * Linha menor abaixo de uma série: percentis e máximo na janela atual.
+ */
+void pctLine(float x, float y, const LatencyStats& st, const char* unit, const char* fmt) {
+    char num[4][24];
+    snprintf(num[0], sizeof(num[0]), fmt, st.p50);
+    snprintf(num[1], sizeof(num[1]), fmt, st.p95);
+    snprintf(num[2], sizeof(num[2]), fmt, st.p99);
+    snprintf(num[3], sizeof(num[3]), fmt, st.max);
+    char buf[128];
+    snprintf(buf, sizeof(buf), "  p50 %s p95 %s p99 %s max %s %s", num[0], num[1], num[2], num[3], unit);
+    glColor4f(0.60f, 0.62f, 0.70f, 0.85f);
+    btext(x, y, buf);
+}
+
 void rect(float x1, float y1, float x2, float y2) {
     glBegin(GL_LINE_LOOP);
     glVertex2f(x1,y1); glVertex2f(x2,y1);
@@ -138,13 +372,15 @@ void BenchMonitor::draw(int winW, int winH) const {
     glPushMatrix(); glLoadIdentity();
 
     const float PW   = 360.0f;
-    const float PH   = 230.0f;
+    const float PH   = 536.0f;
     const float PAD  = 12.0f;
     const float x1   = PAD;
     const float y2   = (float)winH - PAD;
     const float x2   = x1 + PW;
     const float y1   = y2 - PH;
 
+    char buf[128];
+
     glColor4f(0.04f, 0.04f, 0.08f, 0.88f);
     quad(x1, y1, x2, y2);
 
@@ -154,18 +390,21 @@ void BenchMonitor::draw(int winW, int winH) const {
 
     glColor4f(0.55f, 0.70f, 1.00f, 0.95f);
     btext(x1 + 8.0f, y2 - 16.0f, "BENCH MONITOR");
+    snprintf(buf, sizeof(buf), "janela %d frames  [ ]", window);
+    glColor4f(0.45f, 0.50f, 0.70f, 0.85f);
+    btext(x2 - 190.0f, y2 - 16.0f, buf);
     glColor4f(0.30f, 0.35f, 0.55f, 0.80f);
     glBegin(GL_LINES);
     glVertex2f(x1+6.0f, y2-22.0f); glVertex2f(x2-6.0f, y2-22.0f);
     glEnd();
 
-    char buf[128];
     float ty = y2 - 36.0f;
     const float LX  = x1 + 10.0f;
     const float BX  = x1 + 170.0f;
     const float BW  = PW - 180.0f;
     const float BH  = 10.0f;
     const float LS  = 26.0f;
+    const float PS  = 14.0f;
 
     glColor4f(0.85f, 0.95f, 0.70f, 0.95f);
     snprintf(buf, sizeof(buf), "FPS          %.1f", fps);
@@ -181,19 +420,58 @@ void BenchMonitor::draw(int winW, int winH) const {
     btext(LX, ty, buf);
     float ftFrac = std::min(avgFrameMs / 33.0f, 1.0f);
     bar(BX, ty - 2.0f, BW, BH, ftFrac, 0.75f, 0.55f, 0.90f);
+    ty -= PS;
+    pctLine(LX, ty, getFrameStats(), "ms", "%.1f");
     ty -= LS;
 
     glColor4f(0.55f, 0.85f, 1.00f, 0.95f);
     snprintf(buf, sizeof(buf), "C++ render   %.0f µs", avgCppUs);
     btext(LX, ty, buf);
-    float maxUs = std::max(avgCppUs + avgLuaUs, 1.0f);
+    float maxUs = std::max(avgCppUs + avgLuaUs + avgGcUs, 1.0f);
     bar(BX, ty - 2.0f, BW, BH, avgCppUs/maxUs, 0.30f, 0.70f, 1.00f);
+    ty -= PS;
+    pctLine(LX, ty, getCppStats(), "µs", "%.0f");
     ty -= LS;
 
     glColor4f(1.00f, 0.80f, 0.40f, 0.95f);
     snprintf(buf, sizeof(buf), "Lua runtime  %.0f µs", avgLuaUs);
     btext(LX, ty, buf);
     bar(BX, ty - 2.0f, BW, BH, avgLuaUs/maxUs, 1.00f, 0.70f, 0.20f);
+    ty -= PS;
+    pctLine(LX, ty, getLuaStats(), "µs", "%.0f");
+    ty -= LS;
+
+    glColor4f(0.95f, 0.60f, 0.75f, 0.95f);
+    snprintf(buf, sizeof(buf), "Lua GC       %.0f µs", avgGcUs);
+    btext(LX, ty, buf);
+    bar(BX, ty - 2.0f, BW, BH, avgGcUs/maxUs, 0.95f, 0.45f, 0.65f);
+    ty -= PS;
+    pctLine(LX, ty, getGcStats(), "µs", "%.0f");
+    ty -= LS;
+
+    glColor4f(0.75f, 0.70f, 1.00f, 0.95f);
+    snprintf(buf, sizeof(buf), "Workers      %.0f µs", avgWorkerUs);
+    btext(LX, ty, buf);
+    bar(BX, ty - 2.0f, BW, BH, std::min(avgWorkerUs/maxUs, 1.0f), 0.60f, 0.55f, 0.95f);
+    ty -= PS;
+    pctLine(LX, ty, getWorkerStats(), "µs", "%.0f");
+    ty -= LS;
+
+    glColor4f(0.55f, 0.95f, 0.95f, 0.95f);
+    if (gpuSupport == 0) {
+        snprintf(buf, sizeof(buf), "GPU render   n/a (sem timer query)");
+        btext(LX, ty, buf);
+    } else {
+        float gb = getGpuUs(GPU_BACKGROUND), gc = getGpuUs(GPU_CUBE), gu = getGpuUs(GPU_UI);
+        snprintf(buf, sizeof(buf), "GPU render   %.0f µs", gb + gc + gu);
+        btext(LX, ty, buf);
+        float gpuMax = std::max(gb + gc + gu, avgCppUs);
+        bar(BX, ty - 2.0f, BW, BH, (gb + gc + gu) / std::max(gpuMax, 1.0f), 0.30f, 0.90f, 0.90f);
+        ty -= PS;
+        snprintf(buf, sizeof(buf), "  fundo %.0f cubo %.0f UI %.0f µs", gb, gc, gu);
+        glColor4f(0.60f, 0.62f, 0.70f, 0.85f);
+        btext(LX, ty, buf);
+    }
     ty -= LS;
 
     long rss = getRssKb();
@@ -207,14 +485,43 @@ void BenchMonitor::draw(int winW, int winH) const {
     bar(BX, ty - 2.0f, BW, BH, memFrac, 0.70f, 0.60f, 0.85f);
     ty -= LS;
 
+    char bytesBuf[32];
     glColor4f(0.70f, 0.95f, 0.80f, 0.95f);
-    if (texKb > 0)
-        snprintf(buf, sizeof(buf), "Tex cache    %d tex / ~%ld kB", texCount, texKb);
+    formatBytes(bytesBuf, sizeof(bytesBuf), texInfo.gpuBytes);
+    if (texInfo.uniqueTextures > 0)
+        snprintf(buf, sizeof(buf), "Tex GPU      %d tex / %s", texInfo.uniqueTextures, bytesBuf);
     else
-        snprintf(buf, sizeof(buf), "Tex cache    %d tex / sem foto", texCount);
+        snprintf(buf, sizeof(buf), "Tex GPU      sem foto");
     btext(LX, ty, buf);
-    float texFrac = std::min(texCount / 6.0f, 1.0f);
+    float texFrac = std::min(texInfo.gpuBytes / (64.0f * 1024.0f * 1024.0f), 1.0f);
     bar(BX, ty - 2.0f, BW, BH, texFrac, 0.35f, 0.85f, 0.55f);
+    ty -= 18.0f;
+
+    glColor4f(0.60f, 0.80f, 0.70f, 0.90f);
+    formatBytes(bytesBuf, sizeof(bytesBuf), texInfo.stagingBytes);
+    snprintf(buf, sizeof(buf), "Tex staging  %s (CPU)", bytesBuf);
+    btext(LX, ty, buf);
+    ty -= 16.0f;
+
+    for (int i = 0; i < 6; ++i) {
+        const TexFaceInfo& f = texInfo.faces[i];
+        if (f.bytes > 0) {
+            formatBytes(bytesBuf, sizeof(bytesBuf), f.bytes);
+            snprintf(buf, sizeof(buf), "  face %d  %dx%d %s %dmip %s", i, f.width, f.height,
+                     formatName(f.internalFormat), f.mipLevels, bytesBuf);
+            glColor4f(0.75f, 0.85f, 0.80f, 0.90f);
+        } else {
+            snprintf(buf, sizeof(buf), "  face %d  -", i);
+            glColor4f(0.45f, 0.50f, 0.55f, 0.80f);
+        }
+        btext(LX, ty, buf);
+        ty -= 14.0f;
+    }
+    ty -= LS - 14.0f;
+
+    glColor4f(0.70f, 0.75f, 0.90f, 0.90f);
+    snprintf(buf, sizeof(buf), "Relogio      %s t %.3f s dt %.2f ms", clockMode, clockTime, clockDelta * 1000.0);
+    btext(LX, ty, buf);
     ty -= LS;
 
     glColor4f(0.30f, 0.35f, 0.55f, 0.80f);
@@ -229,6 +536,12 @@ void BenchMonitor::draw(int winW, int winH) const {
     quad(LX + 55.0f, ty-2.0f, LX+65.0f, ty+8.0f);
     glColor4f(0.80f, 0.80f, 0.85f, 0.90f);
     btext(LX + 69.0f, ty, "Lua");
+    glColor4f(0.95f, 0.45f, 0.65f, 0.80f);
+    quad(LX + 110.0f, ty-2.0f, LX+120.0f, ty+8.0f);
+    glColor4f(0.80f, 0.80f, 0.85f, 0.90f);
+    btext(LX + 124.0f, ty, "GC");
+
+    drawBridge(x2 + PAD, y2);
 
     glPopMatrix();
     glMatrixMode(GL_PROJECTION);
@@ -239,4 +552,148 @@ void BenchMonitor::draw(int winW, int winH) const {
     glEnable(GL_DEPTH_TEST);
 }
 
+/*
+ * Segundo painel: um bloco por ponto de entrada da ponte com chamadas,
+ * tempo e a fatia do tempo total de Lua (barra), latências, erros,
+ * fallbacks e a maior pilha vista. Erros, fallbacks e vazamentos ficam em
+ * vermelho quando não são zero. No pé, a memória do lua_State, o pool de
+ * tarefas e o tempo do init da ponte.
+ */
+void BenchMonitor::drawBridge(float x1, float y2) const {
+    const float PW = 440.0f;
+    const float PH = 536.0f;
+    const float x2 = x1 + PW;
+    const float y1 = y2 - PH;
+    const float LX = x1 + 10.0f;
+    const float BX = x1 + 300.0f;
+    const float BW = PW - 310.0f;
+
+    char buf[128];
+
+    glColor4f(0.04f, 0.04f, 0.08f, 0.88f);
+    quad(x1, y1, x2, y2);
+    glColor4f(0.35f, 0.45f, 0.90f, 0.70f);
+    glLineWidth(1.2f);
+    rect(x1, y1, x2, y2);
+
+    glColor4f(0.55f, 0.70f, 1.00f, 0.95f);
+    btext(x1 + 8.0f, y2 - 16.0f, "PONTE LUA");
+    glColor4f(0.45f, 0.50f, 0.70f, 0.85f);
+    btext(x2 - 150.0f, y2 - 16.0f, "J grava JSON");
+    glColor4f(0.30f, 0.35f, 0.55f, 0.80f);
+    glBegin(GL_LINES);
+    glVertex2f(x1+6.0f, y2-22.0f); glVertex2f(x2-6.0f, y2-22.0f);
+    glEnd();
+
+    double totalUs = 0.0;
+    long long totalCalls = 0;
+    for (const auto& b : bridgeInfo) { totalUs += b.totalUs; totalCalls += b.calls; }
+
+    float ty = y2 - 36.0f;
+    for (const auto& b : bridgeInfo) {
+        glColor4f(1.00f, 0.80f, 0.40f, 0.95f);
+        snprintf(buf, sizeof(buf), "%-22s %10lld", b.name, b.calls);
+        btext(LX, ty, buf);
+        bar(BX, ty - 2.0f, BW, 10.0f, totalUs > 0.0 ? (float)(b.totalUs / totalUs) : 0.0f,
+            1.00f, 0.70f, 0.20f);
+        ty -= 14.0f;
+
+        float mean = b.calls ? (float)(b.totalUs / b.calls) : 0.0f;
+        snprintf(buf, sizeof(buf), "  med %.1f p50 %.0f p99 %.0f max %.0f µs",
+                 mean, b.p50Us, b.p99Us, b.maxUs);
+        glColor4f(0.60f, 0.62f, 0.70f, 0.85f);
+        btext(LX, ty, buf);
+        ty -= 14.0f;
+
+        snprintf(buf, sizeof(buf), "  erros %lld fallback %lld pilha %d vaz %lld",
+                 b.errors, b.fallbacks, b.stackMax, b.stackLeaks);
+        if (b.errors || b.fallbacks || b.stackLeaks) glColor4f(1.00f, 0.40f, 0.35f, 0.95f);
+        else                                          glColor4f(0.45f, 0.50f, 0.55f, 0.80f);
+        btext(LX, ty, buf);
+        ty -= 22.0f;
+    }
+
+    glColor4f(0.85f, 0.85f, 0.90f, 0.95f);
+    snprintf(buf, sizeof(buf), "Total        %.1f ms em %lld chamadas", totalUs / 1000.0, totalCalls);
+    btext(LX, ty, buf);
+    ty -= 22.0f;
+
+    char live[32], peak[32], pool[32];
+    formatBytes(live, sizeof(live), luaMem.liveBytes);
+    formatBytes(peak, sizeof(peak), luaMem.peakBytes);
+    formatBytes(pool, sizeof(pool), luaMem.poolBytes);
+    glColor4f(0.85f, 0.85f, 0.85f, 0.90f);
+    snprintf(buf, sizeof(buf), "Mem Lua      %s pico %s pool %s", live, peak, pool);
+    btext(LX, ty, buf);
+    if (luaMem.capBytes > 0)
+        bar(BX, ty - 2.0f, BW, 10.0f, std::min((float)luaMem.liveBytes / luaMem.capBytes, 1.0f),
+            0.70f, 0.60f, 0.85f);
+    ty -= 14.0f;
+
+    snprintf(buf, sizeof(buf), "  aloc %llu (pool %llu) realoc %llu liber %llu falhas %llu",
+             luaMem.allocs, luaMem.pooled, luaMem.reallocs, luaMem.frees, luaMem.failures);
+    if (luaMem.failures) glColor4f(1.00f, 0.40f, 0.35f, 0.95f);
+    else                 glColor4f(0.60f, 0.62f, 0.70f, 0.85f);
+    btext(LX, ty, buf);
+    ty -= 14.0f;
+
+    snprintf(buf, sizeof(buf), "  ciclos do coletor %llu", luaMem.gcCycles);
+    glColor4f(0.60f, 0.62f, 0.70f, 0.85f);
+    btext(LX, ty, buf);
+    ty -= 22.0f;
+
+    glColor4f(0.85f, 0.85f, 0.90f, 0.95f);
+    snprintf(buf, sizeof(buf), "Pool         %d threads, %llu tarefas, %llu roubadas",
+             poolInfo.threads, poolInfo.tasks, poolInfo.steals);
+    btext(LX, ty, buf);
+    ty -= 14.0f;
+
+    // o init inteiro e a parte dele gasta nos scripts
+    float initUs = 0.0f, scriptsUs = 0.0f;
+    for (const auto& f : initPhases) {
+        initUs += f.us;
+        if (strstr(f.name, ".lua")) scriptsUs += f.us;
+    }
+    snprintf(buf, sizeof(buf), "Init Lua     %.2f ms (scripts %.2f ms)", initUs / 1000.0f, scriptsUs / 1000.0f);
+    btext(LX, ty, buf);
+}
+
+/*
+ * JSON das estatísticas da ponte, no mesmo estilo do relatório do
+ * headless: chaves em português, tempos em µs.
+ */
+bool BenchMonitor::dumpBridgeJson(const char* path) const {
+    std::ofstream out(path);
+    if (!out) return false;
+    char buf[512];
+    out << "{\"ponte\":[";
+    for (size_t i = 0; i < bridgeInfo.size(); ++i) {
+        const BridgeCallInfo& b = bridgeInfo[i];
+        double mean = b.calls ? b.totalUs / b.calls : 0.0;
+        snprintf(buf, sizeof(buf),
+                 "%s{\"ponto\":\"%s\",\"chamadas\":%lld,\"erros\":%lld,\"fallbacks\":%lld,"
+                 "\"vazamentos_pilha\":%lld,\"pilha_max\":%d,\"total_us\":%.3f,\"media_us\":%.3f,"
+                 "\"min_us\":%.3f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.3f}",
+                 i ? "," : "", b.name, b.calls, b.errors, b.fallbacks, b.stackLeaks, b.stackMax,
+                 b.totalUs, mean, b.calls ? b.minUs : 0.0f, b.p50Us, b.p99Us, b.maxUs);
+        out << buf;
+    }
+    snprintf(buf, sizeof(buf),
+             "],\"memoria_lua\":{\"vivos\":%lld,\"pico\":%lld,\"pool\":%lld,\"limite\":%lld,"
+             "\"alocacoes\":%llu,\"do_pool\":%llu,\"realocacoes\":%llu,\"liberacoes\":%llu,"
+             "\"falhas\":%llu,\"ciclos_gc\":%llu},"
+             "\"pool\":{\"threads\":%d,\"tarefas\":%llu,\"roubadas\":%llu},\"init\":[",
+             luaMem.liveBytes, luaMem.peakBytes, luaMem.poolBytes, luaMem.capBytes,
+             luaMem.allocs, luaMem.pooled, luaMem.reallocs, luaMem.frees, luaMem.failures,
+             luaMem.gcCycles, poolInfo.threads, poolInfo.tasks, poolInfo.steals);
+    out << buf;
+    for (size_t i = 0; i < initPhases.size(); ++i) {
+        snprintf(buf, sizeof(buf), "%s{\"fase\":\"%s\",\"us\":%.1f}",
+                 i ? "," : "", initPhases[i].name, initPhases[i].us);
+        out << buf;
+    }
+    out << "]}" << std::endl;
+    return (bool)out;
+}
+
 #endif /* BENCH_MODE */
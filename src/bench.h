@@ -2,7 +2,8 @@
  * bench.h
  *
  * Monitor de performance mede FPS, tempo de frame,
- * tempo isolado de Lua vs C++, RSS de memória e uso do cache de texturas.
+ * tempo isolado de Lua vs C++, a coleta de lixo do Lua, RSS de memória e a memória exata das
+ * texturas, por face e no total, incluindo os buffers de upload.
  * Os timers usam std::chrono::high_resolution_clock e as médias são calculadas
  * sobre uma janela dos últimos history frames.
  */
@@ -12,40 +13,226 @@
 
 #ifdef BENCH_MODE
 
+#include <atomic>
 #include <chrono>
-#include <deque>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 using BenchClock = std::chrono::high_resolution_clock;
 using BenchTP    = BenchClock::time_point;
 
+/*
+ * Textura de uma face como o driver a alocou. bytes == 0 quando a face
+ * não tem foto. Faces com a mesma foto repetem a mesma textura.
+ */
+struct TexFaceInfo {
+    int       width;
+    int       height;
+    unsigned  internalFormat;
+    int       mipLevels;
+    long long bytes;
+};
+
+/*
+ * Memória de texturas: por face, total residente na GPU (texturas únicas)
+ * e buffers de CPU usados no upload (PBO e imagens decodificadas na fila).
+ */
+struct TexMemInfo {
+    TexFaceInfo faces[6];
+    int         uniqueTextures;
+    long long   gpuBytes;
+    long long   stagingBytes;
+};
+
 struct FrameSnap {
     float frameMs;
     float luaUs;
     float cppUs;
+    float gcUs;
+    float workerUs;
+};
+
+/*
+ * Histograma de latência em baldes logarítmicos, no estilo HDR: cada
+ * potência de 2 é dividida em 16 baldes lineares, então o erro relativo de
+ * um percentil fica abaixo de 1/16. Valores em µs inteiros, de 0 a 2^32.
+ * Os contadores são um array fixo; add e remove não alocam.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB_COUNT = 1 << SUB_BITS;
+    static constexpr int BUCKETS  = SUB_COUNT + (32 - SUB_BITS) * SUB_COUNT;
+
+    void add(float us)    { ++counts[bucketOf(us)]; ++total; }
+    void remove(float us) { --counts[bucketOf(us)]; --total; }
+
+    /*
+     * Limite superior do balde que contém o percentil p (0–100), em µs.
+     */
+    float percentile(float p) const;
+
+private:
+    uint32_t counts[BUCKETS] = {};
+    uint32_t total = 0;
+
+    static int      bucketOf(float us);
+    static uint32_t upperBound(int bucket);
+};
+
+/*
+ * Estatísticas acumuladas de um ponto de entrada da ponte Lua desde o
+ * início do programa. errors conta lua_pcall que falhou; fallbacks conta
+ * as chamadas respondidas pelo C++ (sem estado, sem função em Lua ou depois
+ * de um erro). stackLeaks conta chamadas que deixaram a pilha Lua maior ou
+ * menor do que a encontraram.
+ */
+struct BridgeCallInfo {
+    const char* name;
+    long long   calls;
+    long long   errors;
+    long long   fallbacks;
+    long long   stackLeaks;
+    double      totalUs;
+    float       minUs, maxUs;
+    float       p50Us, p99Us;
+    int         stackMax;
+};
+
+/*
+ * Memória do lua_State vista pelo alocador da ponte. poolBytes são os
+ * blocos reservados para as classes pequenas; capBytes == 0 sem limite.
+ */
+struct LuaMemInfo {
+    long long liveBytes;
+    long long peakBytes;
+    long long poolBytes;
+    long long capBytes;
+    unsigned long long allocs;
+    unsigned long long frees;
+    unsigned long long reallocs;
+    unsigned long long pooled;
+    unsigned long long failures;
+    unsigned long long gcCycles;
+};
+
+/*
+ * Uma fase do init da ponte Lua (estado, bibliotecas, cada script,
+ * referências) e quanto tempo levou.
+ */
+struct InitPhaseInfo {
+    const char* name;
+    float       us;
+};
+
+/*
+ * Pool de tarefas compartilhado: threads, tarefas já executadas e quantas
+ * delas foram roubadas da fila de outra thread.
+ */
+struct PoolInfo {
+    int threads;
+    unsigned long long tasks;
+    unsigned long long steals;
+};
+
+/*
+ * Passes da cena medidos na GPU com GL_TIME_ELAPSED.
+ */
+enum GpuPass {
+    GPU_BACKGROUND,
+    GPU_CUBE,
+    GPU_UI,
+    GPU_PASS_COUNT
+};
+
+/*
+ * Resumo de uma série na janela atual, na unidade da série.
+ */
+struct LatencyStats {
+    float mean;
+    float p50, p95, p99;
+    float max;
 };
 
 class BenchMonitor {
 public:
-    static constexpr int HISTORY = 90;
+    static constexpr int HISTORY     = 90;
+    static constexpr int MAX_HISTORY = 1024;
 
     void frameBegin();
     void frameEnd();
 
-    void luaBegin();
-    void luaEnd();
+    /*
+     * Soma 'elapsed' no acumulador da categoria no frame atual. Chamado
+     * pelo ScopedTimer (bench_scope.h); pode vir de qualquer thread, mas só
+     * a que chamou frameBegin conta no frame. O tempo das outras (a
+     * simulação das estrelas, tarefas do pool) vai para a série das
+     * threads de fundo, que soma o que terminou entre dois frameEnd.
+     */
+    void addCategoryTime(int category, BenchClock::duration elapsed);
+
+    /*
+     * Tempo de GPU de um passe. As queries ficam num anel de GPU_FRAMES
+     * frames: o resultado de um frame é lido GPU_FRAMES frames depois, quando
+     * já está pronto, sem travar o pipeline. Se ainda não estiver, o passe
+     * não é medido nesse frame. Sem GL_ARB_timer_query as chamadas não fazem
+     * nada. Os passes não podem ser aninhados.
+     */
+    void gpuBegin(GpuPass pass);
+    void gpuEnd();
+
+    void setTexInfo(const TexMemInfo& info);
+
+    /*
+     * Estatísticas da ponte Lua mostradas no segundo painel. Vêm prontas da
+     * LuaBridge; o monitor só guarda a cópia para desenhar e exportar.
+     */
+    void setBridgeInfo(const std::vector<BridgeCallInfo>& info) { bridgeInfo = info; }
+    const std::vector<BridgeCallInfo>& getBridgeInfo() const { return bridgeInfo; }
+
+    void setLuaMemInfo(const LuaMemInfo& info) { luaMem = info; }
+    const LuaMemInfo& getLuaMemInfo() const { return luaMem; }
+
+    void setPoolInfo(const PoolInfo& info) { poolInfo = info; }
 
-    void cppRenderBegin();
-    void cppRenderEnd();
+    void setInitPhases(const std::vector<InitPhaseInfo>& phases) { initPhases = phases; }
 
-    void setTexInfo(int activeCount, long estimatedKb);
+    /*
+     * Grava as estatísticas da ponte em JSON, um objeto por ponto de
+     * entrada, e a memória do lua_State. Retorna false se o arquivo não
+     * abrir.
+     */
+    bool dumpBridgeJson(const char* path) const;
+
+    /*
+     * Estado do relógio da cena no frame atual, só para exibição. Os tempos
+     * de custo continuam medidos no relógio real.
+     */
+    void setClockInfo(const char* mode, double simTime, double simDelta);
+
+    /*
+     * Tamanho da janela, em frames, usada nas médias e nos percentis
+     * (1 a MAX_HISTORY). Encolher descarta os frames mais antigos; crescer
+     * só vale para os frames que chegarem depois.
+     */
+    void setWindow(int frames);
+    int  getWindow() const { return window; }
 
     float getFPS()       const { return fps; }
     float getFrameMs()   const { return avgFrameMs; }
     float getLuaUs()     const { return avgLuaUs; }
     float getCppUs()     const { return avgCppUs; }
-    int   getTexCount()  const { return texCount; }
-    long  getTexKb()     const { return texKb; }
+    float getGcUs()      const { return avgGcUs; }
+    float getWorkerUs()  const { return avgWorkerUs; }
+    float getGpuUs(GpuPass pass) const;
+    const TexMemInfo& getTexInfo() const { return texInfo; }
+
+    LatencyStats getFrameStats() const;
+    LatencyStats getLuaStats()   const;
+    LatencyStats getCppStats()   const;
+    LatencyStats getGcStats()    const;
+    LatencyStats getWorkerStats() const;
 
     static long getRssKb();
 
@@ -53,10 +240,9 @@ public:
 
 private:
     BenchTP frameStart;
-    BenchTP luaStart;
-    BenchTP cppStart;
-    double  luaAccumUs  = 0.0;
-    double  cppAccumUs  = 0.0;
+    static constexpr int CATEGORIES = 3;
+    std::atomic<int64_t> categoryNs[CATEGORIES] = {};
+    std::atomic<int64_t> workerNs{0};
 
     int     frameCount  = 0;
     double  fpsAccumMs  = 0.0;
@@ -64,15 +250,56 @@ private:
     bool    timerInit   = false;
     float   fps         = 0.0f;
 
-    std::deque<FrameSnap> history;
+    FrameSnap history[MAX_HISTORY];
+    int       head   = 0;
+    int       count  = 0;
+    int       window = HISTORY;
+    double    sumFrameMs = 0.0;
+    double    sumLuaUs   = 0.0;
+    double    sumCppUs   = 0.0;
+    double    sumGcUs    = 0.0;
+    double    sumWorkerUs = 0.0;
+    LatencyHistogram histFrame;
+    LatencyHistogram histLua;
+    LatencyHistogram histCpp;
+    LatencyHistogram histGc;
+    LatencyHistogram histWorker;
     float avgFrameMs = 0.0f;
     float avgLuaUs   = 0.0f;
     float avgCppUs   = 0.0f;
+    float avgGcUs    = 0.0f;
+    float avgWorkerUs = 0.0f;
+
+    void pushSnap(float fms, float lus, float cus, float gus, float wus);
+    void dropOldest();
+    void updateAverages();
+    void drawBridge(float x1, float y2) const;
+    LatencyStats stats(const LatencyHistogram& h, float FrameSnap::*field,
+                       float mean, float toUs) const;
+
+    TexMemInfo texInfo = {};
+    std::vector<BridgeCallInfo> bridgeInfo;
+    LuaMemInfo luaMem = {};
+    PoolInfo poolInfo = {};
+    std::vector<InitPhaseInfo> initPhases;
+
+    const char* clockMode  = "parede";
+    double      clockTime  = 0.0;
+    double      clockDelta = 0.0;
 
-    void pushSnap(float fms, float lus, float cus);
+    static constexpr int GPU_FRAMES = 4;
+    int      gpuSupport = -1;
+    int      gpuFrame   = 0;
+    int      gpuActive  = -1;
+    unsigned gpuQueries[GPU_FRAMES][GPU_PASS_COUNT] = {};
+    bool     gpuPending[GPU_FRAMES][GPU_PASS_COUNT] = {};
+    float    gpuSamples[GPU_PASS_COUNT][HISTORY]    = {};
+    int      gpuHead[GPU_PASS_COUNT]  = {};
+    int      gpuCount[GPU_PASS_COUNT] = {};
+    double   gpuSumUs[GPU_PASS_COUNT] = {};
 
-    int  texCount = 0;
-    long texKb    = 0;
+    bool gpuAvailable();
+    void gpuPushSample(int pass, float us);
 };
 
 extern BenchMonitor gBench;
@@ -0,0 +1,64 @@
+/*
+ * bench_scope.h
+ *
+ * Cronômetros de escopo do monitor de performance. Cada categoria é um tipo
+ * (bench::Lua, bench::Render, bench::GC) e o ScopedTimer<Categoria> soma o
+ * tempo do escopo no acumulador dela no frame atual, se rodou na thread do
+ * frame; nas outras threads o tempo vai para a série das threads de fundo.
+ * Categorias diferentes se aninham livremente; dentro da mesma categoria só
+ * o escopo mais externo de cada thread conta, para não somar o mesmo
+ * intervalo duas vezes.
+ *
+ * No build normal BENCH_SCOPE não gera código nenhum; no cubo_bench são
+ * duas leituras de steady_clock e uma soma atômica por escopo.
+ */
+
+#ifndef BENCH_SCOPE_H
+#define BENCH_SCOPE_H
+
+#include "trace.h"
+
+namespace bench {
+
+struct Lua    { static constexpr int index = 0; static constexpr const char* name = "Lua";    };
+struct Render { static constexpr int index = 1; static constexpr const char* name = "Render"; };
+struct GC     { static constexpr int index = 2; static constexpr const char* name = "GC";     };
+
+constexpr int CATEGORY_COUNT = 3;
+
+}
+
+#ifdef BENCH_MODE
+
+#include "bench.h"
+
+template <class Category>
+class ScopedTimer {
+public:
+    ScopedTimer() : outermost(depth()++ == 0) {
+        if (outermost) start = BenchClock::now();
+    }
+    ~ScopedTimer() {
+        --depth();
+        if (outermost) gBench.addCategoryTime(Category::index, BenchClock::now() - start);
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    // um contador por categoria e por thread: cada instanciação do template
+    // tem o seu thread_local.
+    static int& depth() { thread_local int d = 0; return d; }
+
+    bool    outermost;
+    BenchTP start;
+};
+
+#define BENCH_SCOPE(Category) ScopedTimer<Category> TRACE_CONCAT(benchScope_, __LINE__)
+
+#else
+
+#define BENCH_SCOPE(Category) ((void)0)
+
+#endif /* BENCH_MODE */
+#endif /* BENCH_SCOPE_H */
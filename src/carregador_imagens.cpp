@@ -0,0 +1,106 @@
+/*
+ * carregador_imagens.cpp
+ *
+ * Decodificação das fotos no pool de tarefas. Nenhuma chamada OpenGL
+ * acontece aqui; o upload da textura fica com o Cubo, na thread do contexto.
+ *
+ * Cada pedido enfileirado manda uma tarefa ao pool, e cada tarefa atende o
+ * pedido mais antigo que ainda estiver na fila. Um pedido cancelado sai da
+ * fila e a tarefa dele acaba encontrando a fila vazia e volta sem fazer nada.
+ */
+
+#include "carregador_imagens.h"
+#include "pool_tarefas.h"
+#include "trace.h"
+#include <algorithm>
+
+CarregadorImagens::CarregadorImagens() : tarefasNoPool(0), bytesConcluidos(0) {
+    for (int i = 0; i < 6; ++i) geracoes[i] = 0;
+}
+
+/*
+ * As tarefas guardam 'this'; espera as que já foram enviadas terminarem.
+ * Os pedidos que sobraram são descartados antes, para isso ser rápido.
+ */
+CarregadorImagens::~CarregadorImagens() {
+    std::unique_lock<std::mutex> trava(mutexPedidos);
+    pedidos.clear();
+    cvPedidos.wait(trava, [this] { return tarefasNoPool == 0; });
+}
+
+void CarregadorImagens::solicitar(int face, const std::string& caminho, const std::string& chave) {
+    if (face < 0 || face >= 6) return;
+    unsigned geracao = ++geracoes[face];
+    {
+        std::lock_guard<std::mutex> trava(mutexPedidos);
+        pedidos.erase(std::remove_if(pedidos.begin(), pedidos.end(),
+                                     [face](const Pedido& p) { return p.face == face; }),
+                      pedidos.end());
+        pedidos.push_back({face, geracao, caminho, chave});
+        ++tarefasNoPool;
+    }
+    PoolTarefas::compartilhado().enviar([this] { processarPedido(); });
+}
+
+void CarregadorImagens::cancelar(int face) {
+    if (face < 0 || face >= 6) return;
+    ++geracoes[face];
+    std::lock_guard<std::mutex> trava(mutexPedidos);
+    pedidos.erase(std::remove_if(pedidos.begin(), pedidos.end(),
+                                 [face](const Pedido& p) { return p.face == face; }),
+                  pedidos.end());
+}
+
+bool CarregadorImagens::retirarConcluido(ImagemCarregada& out) {
+    std::lock_guard<std::mutex> trava(mutexConcluidos);
+    while (!concluidos.empty()) {
+        Concluido c = std::move(concluidos.front());
+        concluidos.pop_front();
+        bytesConcluidos -= c.resultado.imagem.pixels.size();
+        if (!atual(c.resultado.face, c.geracao)) continue;
+        out = std::move(c.resultado);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Uma tarefa: pega o pedido mais antigo, confere se ainda é o mais recente
+ * da face, decodifica e confere de novo antes de publicar — um pedido mais
+ * novo pode ter chegado durante a decodificação.
+ */
+void CarregadorImagens::processarPedido() {
+    Pedido pedido;
+    bool temPedido = false;
+    {
+        std::lock_guard<std::mutex> trava(mutexPedidos);
+        if (!pedidos.empty()) {
+            pedido = std::move(pedidos.front());
+            pedidos.pop_front();
+            temPedido = true;
+        }
+    }
+
+    if (temPedido && atual(pedido.face, pedido.geracao)) {
+        Concluido c;
+        c.geracao            = pedido.geracao;
+        c.resultado.face     = pedido.face;
+        c.resultado.caminho  = pedido.caminho;
+        c.resultado.chave    = pedido.chave;
+        {
+            TRACE_SCOPE("decodificarImagem");
+            c.resultado.ok = decodificarImagem(pedido.caminho, c.resultado.imagem);
+        }
+
+        if (atual(pedido.face, pedido.geracao)) {
+            std::lock_guard<std::mutex> trava(mutexConcluidos);
+            bytesConcluidos += c.resultado.imagem.pixels.size();
+            concluidos.push_back(std::move(c));
+        }
+    }
+
+    // avisa com a trava na mão: assim que ela sai, o destrutor pode rodar
+    std::lock_guard<std::mutex> trava(mutexPedidos);
+    --tarefasNoPool;
+    cvPedidos.notify_all();
+}
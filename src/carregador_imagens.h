@@ -0,0 +1,91 @@
+/*
+ * carregador_imagens.h
+ *
+ * Fila de carregamento das fotos das faces. A decodificação e o recorte
+ * rodam como tarefas no PoolTarefas compartilhado; as imagens prontas ficam numa fila que a
+ * thread do GLUT esvazia a cada frame para fazer o upload. Cada face tem um
+ * contador de geração: um pedido novo para a mesma face invalida os
+ * anteriores, que são descartados antes ou depois de decodificar.
+ */
+
+#ifndef CARREGADOR_IMAGENS_H
+#define CARREGADOR_IMAGENS_H
+
+#include "imagem.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+
+struct ImagemCarregada {
+    int         face;
+    std::string caminho;
+    std::string chave;
+    bool        ok;
+    ImagemDecodificada imagem;
+};
+
+class CarregadorImagens {
+private:
+    struct Pedido {
+        int         face;
+        unsigned    geracao;
+        std::string caminho;
+        std::string chave;
+    };
+
+    struct Concluido {
+        unsigned        geracao;
+        ImagemCarregada resultado;
+    };
+
+    std::mutex              mutexPedidos;
+    std::condition_variable cvPedidos;
+    std::deque<Pedido>      pedidos;
+    int                     tarefasNoPool;   // enviadas e ainda não terminadas
+
+    std::mutex             mutexConcluidos;
+    std::deque<Concluido>  concluidos;
+    std::atomic<size_t>    bytesConcluidos;
+
+    std::atomic<unsigned> geracoes[6];
+
+    bool atual(int face, unsigned geracao) const { return geracoes[face].load() == geracao; }
+    void processarPedido();
+
+public:
+    CarregadorImagens();
+    ~CarregadorImagens();
+
+    CarregadorImagens(const CarregadorImagens&) = delete;
+    CarregadorImagens& operator=(const CarregadorImagens&) = delete;
+
+    /*
+     * Enfileira o carregamento de 'caminho' para a face e cancela qualquer
+     * pedido anterior da mesma face. 'chave' é a chave de cache do arquivo
+     * e volta junto com a imagem pronta. O pool só é criado no primeiro
+     * pedido, e não quando o objeto global é construído.
+     */
+    void solicitar(int face, const std::string& caminho, const std::string& chave);
+
+    /*
+     * Cancela os pedidos pendentes da face, inclusive os que já estão sendo
+     * decodificados; o resultado deles é descartado.
+     */
+    void cancelar(int face);
+
+    /*
+     * Retira uma imagem pronta da fila, pulando as que foram canceladas
+     * depois de decodificadas. Retorna false quando não há nada pronto.
+     * Só deve ser chamada pela thread que faz o upload.
+     */
+    bool retirarConcluido(ImagemCarregada& out);
+
+    /*
+     * Bytes de pixels decodificados parados na fila de prontas.
+     */
+    size_t bytesProntos() const { return bytesConcluidos.load(); }
+};
+
+#endif
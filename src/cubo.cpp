@@ -3,30 +3,28 @@
  *
  * Implementa o cubo com seis faces e vértices de -1 a 1, cada uma com cor
  * e textura independentes. renderizar() aplica as rotações acumuladas e desenha
- * os quads. Quando há textura, primeiro a cor sólida de fundo,
- * depois a imagem com rotação e escala configuradas pelo usuário.
+ * os quads a partir de um VBO que só é regravado para as faces alteradas.
+ * Faces com textura passam por um shader que compõe a cor sólida sob a
+ * imagem e aplica a rotação e a escala configuradas pelo usuário.
  *
- * O color picking funciona renderizando o cubo fora da tela com uma cor única
- * por face e lendo o pixel clicado. o c++ só lê o byte e quem converte
- * R para índice de face é o Lua.
+ * O picking é analítico: o clique vira um raio com a projeção e o viewport
+ * atuais, o raio é levado para o espaço do cubo desfazendo as rotações e
+ * cruzado com a caixa [-1, 1]³ (teste de slabs). Não há render extra nem
+ * leitura da GPU. o c++ devolve o identificador 1–6 da face e quem converte
+ * para índice de face é o Lua.
  */
 
 #include "cubo.h"
+#include "shader.h"
+#include "trace.h"
 #include <iostream>
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <vector>
-#include <fstream>
-#include <sstream>
 
 
-#if __has_include("stb_image.h")
-    #define STB_IMAGE_IMPLEMENTATION
-    #include "stb_image.h"
-    #define HAS_STB_IMAGE 1
-#else
-    #define HAS_STB_IMAGE 0
-#endif
-
 namespace {
 struct Vertex3 {
     float x;
@@ -34,92 +32,67 @@ struct Vertex3 {
     float z;
 };
 
-#ifdef _WIN32
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#include <wincodec.h>
-
-struct ComInit {
-    HRESULT hr;
-    ComInit() : hr(CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED)) {}
-    ~ComInit() {
-        if (SUCCEEDED(hr)) {
-            CoUninitialize();
-        }
-    }
+/*
+ * vértice intercalado do VBO do cubo: posição, cor e coordenada de textura.
+ */
+struct VerticeCubo {
+    float x, y, z;
+    float r, g, b;
+    float u, v;
 };
 
-bool loadImageWicRgb(const std::string& path, int& width, int& height, std::vector<unsigned char>& dataRgb) {
-    ComInit com;
-    if (FAILED(com.hr)) {
-        return false;
-    }
-
-    IWICImagingFactory* factory = nullptr;
-    HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
-    if (FAILED(hr) || !factory) {
-        return false;
-    }
-
-    std::wstring wpath(path.begin(), path.end());
-    IWICBitmapDecoder* decoder = nullptr;
-    hr = factory->CreateDecoderFromFilename(wpath.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder);
-    if (FAILED(hr) || !decoder) {
-        factory->Release();
-        return false;
-    }
-
-    IWICBitmapFrameDecode* frame = nullptr;
-    hr = decoder->GetFrame(0, &frame);
-    if (FAILED(hr) || !frame) {
-        decoder->Release();
-        factory->Release();
-        return false;
-    }
-
-    UINT w = 0;
-    UINT h = 0;
-    hr = frame->GetSize(&w, &h);
-    if (FAILED(hr) || w == 0 || h == 0) {
-        frame->Release();
-        decoder->Release();
-        factory->Release();
-        return false;
-    }
-
-    IWICFormatConverter* converter = nullptr;
-    hr = factory->CreateFormatConverter(&converter);
-    if (FAILED(hr) || !converter) {
-        frame->Release();
-        decoder->Release();
-        factory->Release();
-        return false;
-    }
-
-    hr = converter->Initialize(frame, GUID_WICPixelFormat24bppRGB, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
-    if (FAILED(hr)) {
-        converter->Release();
-        frame->Release();
-        decoder->Release();
-        factory->Release();
-        return false;
-    }
-
-    width = static_cast<int>(w);
-    height = static_cast<int>(h);
-    dataRgb.resize(static_cast<size_t>(width) * static_cast<size_t>(height) * 3u);
-    UINT stride = static_cast<UINT>(width * 3);
-    UINT bufferSize = static_cast<UINT>(dataRgb.size());
-    hr = converter->CopyPixels(nullptr, stride, bufferSize, dataRgb.data());
+/*
+ * layout do VBO: 4 vértices por face, na ordem das faces. A UV de cada
+ * vértice é a do canto sem rotação nem escala; as duas são aplicadas no
+ * fragment shader a partir de uniforms.
+ */
+const int VERTICES_POR_FACE = 4;
+const int TOTAL_VERTICES    = 6 * VERTICES_POR_FACE;
 
-    converter->Release();
-    frame->Release();
-    decoder->Release();
-    factory->Release();
+/*
+ * bytes de foto enviados à GPU por frame. Uma foto maior é dividida em
+ * faixas de linhas ao longo de vários frames, para que a cópia para o PBO
+ * não pese num frame só (4 MiB é uma foto de ~1150x1150 RGB).
+ */
+const size_t ORCAMENTO_ENVIO = 4u << 20;
 
-    return SUCCEEDED(hr);
+/*
+ * shader das faces com textura. Compõe a cor da face por baixo da imagem
+ * usando o alfa da textura, o que antes exigia um segundo quad com blend e
+ * polygon offset. A rotação gira a UV em passos de 90° no sentido horário,
+ * (u, v) → (1 - v, u), e a escala amplia (>= 1) ou encolhe (< 1) a imagem
+ * em torno do centro; fora de [0, 1] sobra só a cor da face.
+ */
+const char* VERTEX_FACE = R"(
+#version 120
+varying vec2 uvFace;
+
+void main() {
+    uvFace = gl_MultiTexCoord0.xy;
+    gl_FrontColor = gl_Color;
+    gl_Position = ftransform();
+}
+)";
+
+const char* FRAGMENT_FACE = R"(
+#version 120
+uniform sampler2D textura;
+uniform float escala;
+uniform int rotacao;
+varying vec2 uvFace;
+
+void main() {
+    vec2 uv = uvFace;
+    if (rotacao == 1)      uv = vec2(1.0 - uv.y, uv.x);
+    else if (rotacao == 2) uv = vec2(1.0 - uv.x, 1.0 - uv.y);
+    else if (rotacao == 3) uv = vec2(uv.y, 1.0 - uv.x);
+    uv = 0.5 + (uv - 0.5) / escala;
+
+    float dentro = step(0.0, uv.x) * step(uv.x, 1.0) * step(0.0, uv.y) * step(uv.y, 1.0);
+    vec4 texel = texture2D(textura, uv);
+    gl_FragColor = vec4(mix(gl_Color.rgb, texel.rgb, texel.a * dentro), 1.0);
 }
-#endif
+)";
 
 void faceVertices(int face, Vertex3& v0, Vertex3& v1, Vertex3& v2, Vertex3& v3) {
     if (face == 0) {
@@ -155,178 +128,136 @@ void faceVertices(int face, Vertex3& v0, Vertex3& v1, Vertex3& v2, Vertex3& v3)
     }
 }
 
-bool loadPpm(const std::string& path, int& width, int& height, std::vector<unsigned char>& data) {
-    std::ifstream file(path.c_str());
-    if (!file.is_open()) {
-        return false;
-    }
-    std::string magic;
-    file >> magic;
-    if (magic != "P3") {
-        return false;
-    }
-    file >> width >> height;
-    int maxVal = 0;
-    file >> maxVal;
-    if (!file.good() || width <= 0 || height <= 0 || maxVal <= 0) {
-        return false;
-    }
-    data.resize(static_cast<size_t>(width) * static_cast<size_t>(height) * 3u);
-    for (int i = 0; i < width * height; ++i) {
-        int r = 0;
-        int g = 0;
-        int b = 0;
-        file >> r >> g >> b;
-        if (!file.good()) {
-            return false;
-        }
-        data[static_cast<size_t>(i) * 3u + 0u] = static_cast<unsigned char>(r * 255 / maxVal);
-        data[static_cast<size_t>(i) * 3u + 1u] = static_cast<unsigned char>(g * 255 / maxVal);
-        data[static_cast<size_t>(i) * 3u + 2u] = static_cast<unsigned char>(b * 255 / maxVal);
-    }
-    return true;
-}
-
-void cropCenterSquare(int& width, int& height, std::vector<unsigned char>& dataRgb) {
-    if (width <= 0 || height <= 0) return;
-    if (width == height) return;
-
-    int side = (width < height) ? width : height;
-    int x0 = (width - side) / 2;
-    int y0 = (height - side) / 2;
-
-    std::vector<unsigned char> cropped(static_cast<size_t>(side) * static_cast<size_t>(side) * 3u);
-    for (int y = 0; y < side; ++y) {
-        int srcY = y0 + y;
-        for (int x = 0; x < side; ++x) {
-            int srcX = x0 + x;
-            size_t src = (static_cast<size_t>(srcY) * static_cast<size_t>(width) + static_cast<size_t>(srcX)) * 3u;
-            size_t dst = (static_cast<size_t>(y) * static_cast<size_t>(side) + static_cast<size_t>(x)) * 3u;
-            cropped[dst + 0u] = dataRgb[src + 0u];
-            cropped[dst + 1u] = dataRgb[src + 1u];
-            cropped[dst + 2u] = dataRgb[src + 2u];
-        }
-    }
-
-    width = side;
-    height = side;
-    dataRgb.swap(cropped);
-}
 }
 
 /*
  * Inicia todas as faces com cor branca e sem textura.
  */
-Cubo::Cubo() : rotacaoX(0), rotacaoY(0), rotacaoZ(0), faceSelecionada(0) {
+Cubo::Cubo() : rotacaoX(0), rotacaoY(0), rotacaoZ(0), faceSelecionada(0), faceDestacada(-1),
+               vboFaces(0), programaFaces(0), uniformEscala(-1), uniformRotacao(-1),
+               pboUpload(0), bytesPbo(0) {
     for (int i = 0; i < 6; ++i) {
         coresFaces[i]           = {1.0f, 1.0f, 1.0f};
         texturasFaces[i]         = 0;
-        texturasFacesTemAlfa[i]  = false;
         escalasTexturasFaces[i]     = 1.0f;
         rotacoesTexturasFaces[i]  = 0;
+        facesSujas[i]            = true;
+    }
+}
+
+/*
+ * Monta os 4 vértices de uma face com a cor atual e a UV base de cada canto.
+ */
+static void montarVerticesFace(int face, const Cor& c, VerticeCubo* out) {
+    Vertex3 v[4];
+    faceVertices(face, v[0], v[1], v[2], v[3]);
+    static const float uvBase[8] = {0,0, 1,0, 1,1, 0,1};
+    for (int i = 0; i < 4; ++i)
+        out[i] = {v[i].x, v[i].y, v[i].z, c.vermelho, c.verde, c.azul, uvBase[i*2], uvBase[i*2+1]};
+}
+
+/*
+ * Cria o VBO e o programa das faces na primeira chamada (precisam do
+ * contexto GL, que não existe quando o Cubo global é construído) e regrava
+ * só as faces sujas com glBufferSubData.
+ */
+void Cubo::atualizarGeometria() {
+    if (!vboFaces) {
+        glGenBuffers(1, &vboFaces);
+        glBindBuffer(GL_ARRAY_BUFFER, vboFaces);
+        glBufferData(GL_ARRAY_BUFFER, TOTAL_VERTICES * sizeof(VerticeCubo), nullptr, GL_DYNAMIC_DRAW);
+        for (int face = 0; face < 6; ++face) facesSujas[face] = true;
+
+        programaFaces = compilarPrograma("faces", VERTEX_FACE, FRAGMENT_FACE);
+        if (programaFaces) {
+            uniformEscala  = glGetUniformLocation(programaFaces, "escala");
+            uniformRotacao = glGetUniformLocation(programaFaces, "rotacao");
+            glUseProgram(programaFaces);
+            glUniform1i(glGetUniformLocation(programaFaces, "textura"), 0);
+            glUseProgram(0);
+        } else {
+            std::cerr << "Shader das faces indisponível: texturas não serão desenhadas" << std::endl;
+        }
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, vboFaces);
+    }
+
+    for (int face = 0; face < 6; ++face) {
+        if (!facesSujas[face]) continue;
+        VerticeCubo vertices[VERTICES_POR_FACE];
+        montarVerticesFace(face, coresFaces[face], vertices);
+        glBufferSubData(GL_ARRAY_BUFFER, face * VERTICES_POR_FACE * sizeof(VerticeCubo),
+                        sizeof(vertices), vertices);
+        facesSujas[face] = false;
     }
 }
 
 /*
- * Desenha os seis quads do cubo. Aplica as rotações acumuladas e
- * percorre as faces: sem textura vai cor sólida direto; com textura faz
- * dois passes, desenhando a cor de fundo antes de sobrepor a imagem com
- * polygon offset para evitar z-fighting. Escala e rotação de textura são
- * aplicadas via remapeamento de UVs.
+ * Desenha o cubo a partir do VBO. Aplica as rotações acumuladas, desenha
+ * as faces sem textura no pipeline fixo em uma única chamada e depois as
+ * faces com textura com o shader, uma passada por face: cor, imagem,
+ * escala e rotação saem do mesmo fragmento, sem blend nem polygon offset.
  */
 void Cubo::renderizar() {
+    TRACE_SCOPE("Cubo::renderizar");
+    atualizarGeometria();
+
     glPushMatrix();
     glRotatef(rotacaoX, 1.0f, 0.0f, 0.0f);
     glRotatef(rotacaoY, 0.0f, 1.0f, 0.0f);
     glRotatef(rotacaoZ, 0.0f, 0.0f, 1.0f);
+
+    const GLsizei stride = sizeof(VerticeCubo);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, (const void*)offsetof(VerticeCubo, x));
+    glColorPointer(3, GL_FLOAT, stride, (const void*)offsetof(VerticeCubo, r));
+    glTexCoordPointer(2, GL_FLOAT, stride, (const void*)offsetof(VerticeCubo, u));
+
+    GLint   inicioSolidas[6];
+    GLsizei contagemSolidas[6];
+    int     nSolidas = 0;
+    bool    usarShader = programaFaces != 0;
     for (int face = 0; face < 6; ++face) {
-        Vertex3 v0;
-        Vertex3 v1;
-        Vertex3 v2;
-        Vertex3 v3;
-        faceVertices(face, v0, v1, v2, v3);
-        Cor c = coresFaces[face];
-        bool hasTexture = texturasFaces[face] != 0;
-
-        if (hasTexture) {
-            float scale = escalasTexturasFaces[face];
-            int   rot   = rotacoesTexturasFaces[face];
-
-            // rot 0=normal, 1=90°CW, 2=180°, 3=270°CW
-            static const float uvTable[4][8] = {
-                {0,0, 1,0, 1,1, 0,1},
-                {1,0, 1,1, 0,1, 0,0},
-                {1,1, 0,1, 0,0, 1,0},
-                {0,1, 0,0, 1,0, 1,1},
-            };
-            const float* uv = uvTable[rot & 3];
-
-            auto mapUV = [&](float u, float v, float lo, float hi) -> std::pair<float,float> {
-                return { lo + u * (hi - lo), lo + v * (hi - lo) };
-            };
-
-            glDisable(GL_TEXTURE_2D);
-            glColor3f(c.vermelho, c.verde, c.azul);
-            glBegin(GL_QUADS);
-            glVertex3f(v0.x, v0.y, v0.z);
-            glVertex3f(v1.x, v1.y, v1.z);
-            glVertex3f(v2.x, v2.y, v2.z);
-            glVertex3f(v3.x, v3.y, v3.z);
-            glEnd();
-
-            glEnable(GL_POLYGON_OFFSET_FILL);
-            glPolygonOffset(-1.0f, -1.0f);
-            glDepthFunc(GL_LEQUAL);
-            glEnable(GL_TEXTURE_2D);
+        if (texturasFaces[face] != 0 && usarShader) continue;
+        inicioSolidas[nSolidas]   = face * VERTICES_POR_FACE;
+        contagemSolidas[nSolidas] = VERTICES_POR_FACE;
+        ++nSolidas;
+    }
+
+    glDisable(GL_TEXTURE_2D);
+    if (nSolidas > 0)
+        glMultiDrawArrays(GL_QUADS, inicioSolidas, contagemSolidas, nSolidas);
+
+    if (nSolidas < 6) {
+        glUseProgram(programaFaces);
+        for (int face = 0; face < 6; ++face) {
+            if (texturasFaces[face] == 0) continue;
+            glUniform1f(uniformEscala, escalasTexturasFaces[face]);
+            glUniform1i(uniformRotacao, rotacoesTexturasFaces[face] & 3);
             glBindTexture(GL_TEXTURE_2D, texturasFaces[face]);
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-            glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-
-            if (scale >= 1.0f) {
-                float lo = 0.5f - 0.5f / scale;
-                float hi = 0.5f + 0.5f / scale;
-                auto [u0,v0uv] = mapUV(uv[0], uv[1], lo, hi);
-                auto [u1,v1uv] = mapUV(uv[2], uv[3], lo, hi);
-                auto [u2,v2uv] = mapUV(uv[4], uv[5], lo, hi);
-                auto [u3,v3uv] = mapUV(uv[6], uv[7], lo, hi);
-                glBegin(GL_QUADS);
-                glTexCoord2f(u0,v0uv); glVertex3f(v0.x, v0.y, v0.z);
-                glTexCoord2f(u1,v1uv); glVertex3f(v1.x, v1.y, v1.z);
-                glTexCoord2f(u2,v2uv); glVertex3f(v2.x, v2.y, v2.z);
-                glTexCoord2f(u3,v3uv); glVertex3f(v3.x, v3.y, v3.z);
-                glEnd();
-            } else {
-                float cx2 = (v0.x+v1.x+v2.x+v3.x)*0.25f;
-                float cy2 = (v0.y+v1.y+v2.y+v3.y)*0.25f;
-                float cz2 = (v0.z+v1.z+v2.z+v3.z)*0.25f;
-                auto sv = [&](const Vertex3& v) -> Vertex3 {
-                    return { cx2+(v.x-cx2)*scale, cy2+(v.y-cy2)*scale, cz2+(v.z-cz2)*scale };
-                };
-                Vertex3 sv0=sv(v0), sv1=sv(v1), sv2=sv(v2), sv3=sv(v3);
-                glBegin(GL_QUADS);
-                glTexCoord2f(uv[0],uv[1]); glVertex3f(sv0.x,sv0.y,sv0.z);
-                glTexCoord2f(uv[2],uv[3]); glVertex3f(sv1.x,sv1.y,sv1.z);
-                glTexCoord2f(uv[4],uv[5]); glVertex3f(sv2.x,sv2.y,sv2.z);
-                glTexCoord2f(uv[6],uv[7]); glVertex3f(sv3.x,sv3.y,sv3.z);
-                glEnd();
-            }
-
-            glDisable(GL_BLEND);
-            glDisable(GL_TEXTURE_2D);
-            glDisable(GL_POLYGON_OFFSET_FILL);
-            glDepthFunc(GL_LESS);
-        } else {
-            glDisable(GL_TEXTURE_2D);
-            glColor3f(c.vermelho, c.verde, c.azul);
-            glBegin(GL_QUADS);
-            glVertex3f(v0.x, v0.y, v0.z);
-            glVertex3f(v1.x, v1.y, v1.z);
-            glVertex3f(v2.x, v2.y, v2.z);
-            glVertex3f(v3.x, v3.y, v3.z);
-            glEnd();
+            glDrawArrays(GL_QUADS, face * VERTICES_POR_FACE, VERTICES_POR_FACE);
         }
+        glUseProgram(0);
+    }
+
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+
+    // contorno da face sob o mouse; ela é sempre frontal, então o contorno
+    // inteiro é visível e pode ser desenhado sem teste de profundidade
+    if (faceDestacada >= 0) {
+        glDisable(GL_DEPTH_TEST);
+        glLineWidth(2.0f);
+        glColor3f(0.95f, 0.85f, 0.35f);
+        glDrawArrays(GL_LINE_LOOP, faceDestacada * VERTICES_POR_FACE, VERTICES_POR_FACE);
+        glLineWidth(1.0f);
+        glEnable(GL_DEPTH_TEST);
     }
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glPopMatrix();
 }
 
@@ -343,14 +274,18 @@ void Cubo::definirRotacao(float x, float y, float z) {
 }
 
 void Cubo::limparFaceSelecionada() {
+    carregador.cancelar(faceSelecionada);
+    descartarEnvios(faceSelecionada);
+    texturas.liberar(texturasFaces[faceSelecionada]);
+    marcarFaceSuja(faceSelecionada);
     coresFaces[faceSelecionada] = {1.0f, 1.0f, 1.0f};
     texturasFaces[faceSelecionada] = 0;
-    texturasFacesTemAlfa[faceSelecionada] = false;
     escalasTexturasFaces[faceSelecionada] = 1.0f;
     rotacoesTexturasFaces[faceSelecionada] = 0;
 }
 
 void Cubo::limparCorFaceSelecionada() {
+    marcarFaceSuja(faceSelecionada);
     coresFaces[faceSelecionada] = {1.0f, 1.0f, 1.0f};
 }
 
@@ -359,88 +294,104 @@ void Cubo::definirCorFace(int face, float r, float g, float b) {
         coresFaces[face].vermelho = r;
         coresFaces[face].verde = g;
         coresFaces[face].azul = b;
+        marcarFaceSuja(face);
     }
 }
 
 /*
- * Renderiza a cena de picking fora do framebuffer visível, com cada face em
- * glColor3ub(i+1, 0, 0). Lê o pixel clicado e retorna o canal R bruto.
- * O valor é passado para bridge.resolverFacePicking para obter o índice de face.
+ * Gira 'v' de -graus em torno do eixo (ax, ay, az) unitário, que é o
+ * inverso de glRotatef com o mesmo ângulo.
  */
-int Cubo::lerPixelPicking(int x, int y) {
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
-
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glDisable(GL_LIGHTING);
-    glDisable(GL_TEXTURE_2D);
-    glShadeModel(GL_FLAT);
-
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
-    glTranslatef(0.0f, 0.0f, -5.0f);
-
-    glRotatef(rotacaoX, 1.0f, 0.0f, 0.0f);
-    glRotatef(rotacaoY, 0.0f, 1.0f, 0.0f);
-    glRotatef(rotacaoZ, 0.0f, 0.0f, 1.0f);
+static Vertex3 desfazerRotacao(const Vertex3& v, float graus, float ax, float ay, float az) {
+    double a = -graus * M_PI / 180.0;
+    double c = std::cos(a), s = std::sin(a);
+    double dot = ax * v.x + ay * v.y + az * v.z;
+    double cx = ay * v.z - az * v.y;
+    double cy = az * v.x - ax * v.z;
+    double cz = ax * v.y - ay * v.x;
+    return { (float)(v.x * c + cx * s + ax * dot * (1.0 - c)),
+             (float)(v.y * c + cy * s + ay * dot * (1.0 - c)),
+             (float)(v.z * c + cz * s + az * dot * (1.0 - c)) };
+}
 
-    glBegin(GL_QUADS);
-
-    glColor3ub(1, 0, 0);
-    glVertex3f(-1.0f, -1.0f,  1.0f);
-    glVertex3f( 1.0f, -1.0f,  1.0f);
-    glVertex3f( 1.0f,  1.0f,  1.0f);
-    glVertex3f(-1.0f,  1.0f,  1.0f);
-
-    glColor3ub(2, 0, 0);
-    glVertex3f(-1.0f, -1.0f, -1.0f);
-    glVertex3f(-1.0f,  1.0f, -1.0f);
-    glVertex3f( 1.0f,  1.0f, -1.0f);
-    glVertex3f( 1.0f, -1.0f, -1.0f);
-
-    glColor3ub(3, 0, 0);
-    glVertex3f(-1.0f,  1.0f, -1.0f);
-    glVertex3f(-1.0f,  1.0f,  1.0f);
-    glVertex3f( 1.0f,  1.0f,  1.0f);
-    glVertex3f( 1.0f,  1.0f, -1.0f);
-
-    glColor3ub(4, 0, 0);
-    glVertex3f(-1.0f, -1.0f, -1.0f);
-    glVertex3f( 1.0f, -1.0f, -1.0f);
-    glVertex3f( 1.0f, -1.0f,  1.0f);
-    glVertex3f(-1.0f, -1.0f,  1.0f);
-
-    glColor3ub(5, 0, 0);
-    glVertex3f( 1.0f, -1.0f, -1.0f);
-    glVertex3f( 1.0f,  1.0f, -1.0f);
-    glVertex3f( 1.0f,  1.0f,  1.0f);
-    glVertex3f( 1.0f, -1.0f,  1.0f);
-
-    glColor3ub(6, 0, 0);
-    glVertex3f(-1.0f, -1.0f, -1.0f);
-    glVertex3f(-1.0f, -1.0f,  1.0f);
-    glVertex3f(-1.0f,  1.0f,  1.0f);
-    glVertex3f(-1.0f,  1.0f, -1.0f);
-
-    glEnd();
-
-    glFlush();
-    glFinish();
-
-    unsigned char pixel[3];
-    glReadPixels(x, viewport[3] - y - 1, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, pixel);
-
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
+/*
+ * Lança um raio pelo pixel (x, y) da janela e devolve a face do cubo que
+ * ele atinge primeiro. Os pontos do raio nos planos near e far saem de
+ * gluUnProject com a projeção e o viewport atuais, no espaço do olho. A
+ * matriz do cubo é a mesma de renderizar(): translação para z = -5 e
+ * rotações X, Y, Z (M = T·Rx·Ry·Rz); para voltar ao espaço do cubo
+ * desfaz-se a translação e depois X, Y e Z, nessa ordem. Depois é o teste de slabs contra [-1, 1]³: a face é o
+ * plano de entrada do raio.
+ */
+ResultadoPicking Cubo::lancarRaioPicking(int x, int y) const {
+    TRACE_SCOPE("Cubo::lancarRaioPicking");
+    ResultadoPicking r = {0, 0.0f, 0.0f, 0.0f};
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    return (int)pixel[0];
+    GLint viewport[4];
+    GLdouble projecao[16];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetDoublev(GL_PROJECTION_MATRIX, projecao);
+    static const GLdouble identidade[16] = {1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1};
+
+    double winX = x + 0.5;
+    double winY = viewport[3] - y - 0.5;
+    double px[2], py[2], pz[2];
+    if (!gluUnProject(winX, winY, 0.0, identidade, projecao, viewport, &px[0], &py[0], &pz[0]) ||
+        !gluUnProject(winX, winY, 1.0, identidade, projecao, viewport, &px[1], &py[1], &pz[1]))
+        return r;
+
+    auto paraCubo = [this](double ex, double ey, double ez) {
+        Vertex3 p = {(float)ex, (float)ey, (float)(ez + 5.0)};
+        p = desfazerRotacao(p, rotacaoX, 1.0f, 0.0f, 0.0f);
+        p = desfazerRotacao(p, rotacaoY, 0.0f, 1.0f, 0.0f);
+        p = desfazerRotacao(p, rotacaoZ, 0.0f, 0.0f, 1.0f);
+        return p;
+    };
+    Vertex3 olho  = paraCubo(0.0, 0.0, 0.0);
+    Vertex3 perto = paraCubo(px[0], py[0], pz[0]);
+    Vertex3 longe = paraCubo(px[1], py[1], pz[1]);
+
+    float origem[3]  = {perto.x, perto.y, perto.z};
+    float direcao[3] = {longe.x - perto.x, longe.y - perto.y, longe.z - perto.z};
+
+    float tEntrada = 0.0f, tSaida = 1.0f;
+    int eixoEntrada = -1;
+    for (int eixo = 0; eixo < 3; ++eixo) {
+        if (std::fabs(direcao[eixo]) < 1e-9f) {
+            if (origem[eixo] < -1.0f || origem[eixo] > 1.0f) return r;
+            continue;
+        }
+        float t1 = (-1.0f - origem[eixo]) / direcao[eixo];
+        float t2 = ( 1.0f - origem[eixo]) / direcao[eixo];
+        if (t1 > t2) std::swap(t1, t2);
+        if (t1 > tEntrada) { tEntrada = t1; eixoEntrada = eixo; }
+        if (t2 < tSaida) tSaida = t2;
+        if (tEntrada > tSaida) return r;
+    }
+    if (eixoEntrada < 0) return r;
+
+    Vertex3 p = {origem[0] + direcao[0] * tEntrada,
+                 origem[1] + direcao[1] * tEntrada,
+                 origem[2] + direcao[2] * tEntrada};
+    float coord = (eixoEntrada == 0) ? p.x : (eixoEntrada == 1) ? p.y : p.z;
+
+    // mesma numeração de faceVertices: 0/1 = z+/z-, 2/3 = y+/y-, 4/5 = x+/x-
+    static const int facePorEixo[3][2] = {{5, 4}, {3, 2}, {1, 0}};
+    int face = facePorEixo[eixoEntrada][coord > 0.0f ? 1 : 0];
+
+    Vertex3 v0, v1, v2, v3;
+    faceVertices(face, v0, v1, v2, v3);
+    auto projetar = [&p, &v0](const Vertex3& aresta) {
+        float ex = aresta.x - v0.x, ey = aresta.y - v0.y, ez = aresta.z - v0.z;
+        return ((p.x - v0.x) * ex + (p.y - v0.y) * ey + (p.z - v0.z) * ez) / 4.0f;
+    };
+
+    r.id = face + 1;
+    r.u  = projetar(v1);
+    r.v  = projetar(v3);
+    float dx = p.x - olho.x, dy = p.y - olho.y, dz = p.z - olho.z;
+    r.distancia = std::sqrt(dx * dx + dy * dy + dz * dz);
+    return r;
 }
 
 /*
@@ -453,92 +404,64 @@ void Cubo::definirFaceSelecionada(int face) {
 }
 
 /*
- * Carrega uma imagem do disco e cria uma textura OpenGL para a face indicada.
- * Tenta stb_image primeiro (se disponível) e cai para o leitor PPP interno.
- * Imagens não quadradas são recortadas ao centro antes de serem enviadas para
- * a GPU. Detecta canal alpha em PNGs e usa GL_RGBA quando necessário.
+ * Define a face com contorno de destaque (hover); -1 remove o destaque.
+ * Retorna true quando mudou, para o chamador só redesenhar nesse caso.
+ */
+bool Cubo::definirFaceDestacada(int face) {
+    if (face < 0 || face >= 6) face = -1;
+    if (face == faceDestacada) return false;
+    faceDestacada = face;
+    return true;
+}
+
+/*
+ * Pede o carregamento de uma imagem do disco para a face indicada. Se o
+ * arquivo (mesmo caminho, tamanho e mtime) já está em alguma face, a
+ * textura é compartilhada na hora. Senão a decodificação roda no
+ * CarregadorImagens e a textura só é trocada em processarCarregamentos,
+ * então a face mantém a foto (ou a cor) atual até a nova estar pronta. Um
+ * pedido novo para a mesma face cancela o anterior.
  */
 bool Cubo::definirFotoFaceDeArquivo(int face, const std::string& path) {
-    if (face < 0 || face >= 6) {
+    if (face < 0 || face >= 6 || path.empty()) {
         return false;
     }
-    int width = 0;
-    int height = 0;
-    std::vector<unsigned char> data;
-    bool hasAlpha = false;
-    bool loaded   = false;
-
-#if HAS_STB_IMAGE
-    {
-        int channels = 0;
-        unsigned char* raw = stbi_load(path.c_str(), &width, &height, &channels, 0);
-        if (raw) {
-            size_t pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
-            if (channels == 4) {
-                hasAlpha = false;
-                for (size_t i = 0; i < pixels; ++i) {
-                    if (raw[i * 4 + 3] < 255) {
-                        hasAlpha = true;
-                        break;
-                    }
-                }
-                data.assign(raw, raw + pixels * 4);
-            } else if (channels == 3) {
-                data.assign(raw, raw + pixels * 3);
-                hasAlpha = false;
-            } else {
-                data.resize(pixels * 3);
-                for (size_t i = 0; i < pixels; ++i) {
-                    unsigned char v = raw[i * static_cast<size_t>(channels)];
-                    data[i * 3 + 0] = v;
-                    data[i * 3 + 1] = v;
-                    data[i * 3 + 2] = v;
-                }
-            }
-            stbi_image_free(raw);
-            loaded = true;
-        } else {
-            std::cerr << "stb_image falhou: " << stbi_failure_reason() << std::endl;
-        }
-    }
-#endif
-
-    if (!loaded) {
-        loaded   = loadPpm(path, width, height, data);
-        hasAlpha = false;
-    }
-
-    if (!loaded) {
+    std::string chave;
+    if (!GerenciadorTexturas::chaveArquivo(path, chave)) {
+        std::cerr << "Imagem não encontrada: " << path << std::endl;
         return false;
     }
-
-    if (texturasFaces[face] != 0) {
-        glDeleteTextures(1, &texturasFaces[face]);
-        texturasFaces[face] = 0;
+    GLuint texId = texturas.adquirir(chave);
+    if (texId != 0) {
+        carregador.cancelar(face);
+        descartarEnvios(face);
+        trocarTexturaFace(face, texId);
+        fotosDoCache.push_back({face, path});
+        return true;
     }
+    carregador.solicitar(face, path, chave);
+    descartarEnvios(face);
+    return true;
+}
 
-    if (hasAlpha) {
-        if (width != height) {
-            int side = (width < height) ? width : height;
-            int x0 = (width - side) / 2;
-            int y0 = (height - side) / 2;
-            std::vector<unsigned char> cropped(static_cast<size_t>(side) * static_cast<size_t>(side) * 4u);
-            for (int y = 0; y < side; ++y) {
-                for (int x = 0; x < side; ++x) {
-                    size_t src = (static_cast<size_t>(y0 + y) * static_cast<size_t>(width) + static_cast<size_t>(x0 + x)) * 4u;
-                    size_t dst = (static_cast<size_t>(y) * static_cast<size_t>(side) + static_cast<size_t>(x)) * 4u;
-                    cropped[dst+0] = data[src+0];
-                    cropped[dst+1] = data[src+1];
-                    cropped[dst+2] = data[src+2];
-                    cropped[dst+3] = data[src+3];
-                }
-            }
-            width = side; height = side;
-            data.swap(cropped);
-        }
-    } else {
-        cropCenterSquare(width, height, data);
-    }
+/*
+ * Coloca a textura 'texId' (já com uma referência adquirida) na face e solta
+ * a referência da anterior. Escala e rotação voltam ao padrão.
+ */
+void Cubo::trocarTexturaFace(int face, GLuint texId) {
+    texturas.liberar(texturasFaces[face]);
+    texturasFaces[face]         = texId;
+    escalasTexturasFaces[face]  = 1.0f;
+    rotacoesTexturasFaces[face] = 0;
+}
+
+/*
+ * Cria a textura da imagem com o armazenamento alocado mas sem pixels; as
+ * linhas chegam depois por enviarFaixa.
+ */
+GLuint Cubo::criarTextura(const ImagemDecodificada& imagem) {
+    GLenum formato        = imagem.temAlfa ? GL_RGBA  : GL_RGB;
+    GLenum formatoInterno = imagem.temAlfa ? GL_RGBA8 : GL_RGB8;
 
     GLuint texId = 0;
     glGenTextures(1, &texId);
@@ -547,19 +470,152 @@ bool Cubo::definirFotoFaceDeArquivo(int face, const std::string& path) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    if (hasAlpha) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
-    } else {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB,  width, height, 0, GL_RGB,  GL_UNSIGNED_BYTE, data.data());
+    glTexImage2D(GL_TEXTURE_2D, 0, formatoInterno, imagem.largura, imagem.altura, 0,
+                 formato, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texId;
+}
+
+/*
+ * Envia a próxima faixa de linhas do envio, com tantas linhas quanto cabem
+ * em 'orcamento' (pelo menos uma), e desconta o que usou. Os pixels são
+ * copiados para um pixel buffer object e o glTexSubImage2D lê do buffer,
+ * de modo que a transferência para a GPU não segura a thread do GLUT. O
+ * buffer é reaproveitado entre faixas e realocado (orphaning) a cada uma.
+ * Se o mapeamento falhar, envia direto da memória do processo. Retorna
+ * true quando a última linha foi enviada.
+ */
+bool Cubo::enviarFaixa(EnvioTextura& envio, size_t& orcamento) {
+    TRACE_SCOPE("Cubo::enviarFaixa");
+    const ImagemDecodificada& imagem = envio.carregada.imagem;
+    GLenum formato = imagem.temAlfa ? GL_RGBA : GL_RGB;
+    size_t bytesLinha = (size_t)imagem.largura * (imagem.temAlfa ? 4u : 3u);
+    int linhas = (int)std::max<size_t>(1, orcamento / std::max<size_t>(1, bytesLinha));
+    linhas = std::min(linhas, imagem.altura - envio.proximaLinha);
+    size_t tamanho = bytesLinha * (size_t)linhas;
+    const unsigned char* inicio = imagem.pixels.data() + bytesLinha * (size_t)envio.proximaLinha;
+
+    if (!pboUpload) glGenBuffers(1, &pboUpload);
+
+    const void* origem = inicio;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pboUpload);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)tamanho, nullptr, GL_STREAM_DRAW);
+    bytesPbo = tamanho;
+    void* destino = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    if (destino) {
+        std::memcpy(destino, inicio, tamanho);
+        if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+            origem = nullptr;
+        }
     }
+    if (origem) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, envio.texId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, envio.proximaLinha, imagem.largura, linhas,
+                    formato, GL_UNSIGNED_BYTE, origem);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-    texturasFaces[face]        = texId;
-    texturasFacesTemAlfa[face] = hasAlpha;
-    escalasTexturasFaces[face]    = 1.0f;
-    rotacoesTexturasFaces[face] = 0;
-    return true;
+    envio.proximaLinha += linhas;
+    orcamento -= std::min(orcamento, tamanho);
+    return envio.proximaLinha >= imagem.altura;
+}
+
+/*
+ * Tira a face dos envios em andamento, porque ela foi limpa ou pediu outra
+ * foto. Um envio que fica sem nenhuma face é abandonado com a textura.
+ */
+void Cubo::descartarEnvios(int face) {
+    for (auto it = envios.begin(); it != envios.end();) {
+        auto& destinos = it->destinos;
+        destinos.erase(std::remove_if(destinos.begin(), destinos.end(),
+                                      [face](const FotoCarregada& f) { return f.face == face; }),
+                       destinos.end());
+        if (destinos.empty()) {
+            glDeleteTextures(1, &it->texId);
+            it = envios.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/*
+ * Esvazia a fila de imagens prontas e avança os envios à GPU. Cada imagem
+ * nova ganha uma textura vazia e entra na fila de envios; se outra face
+ * carregou o mesmo arquivo nesse meio-tempo, reaproveita a textura dela,
+ * pronta ou ainda a caminho, em vez de enviar de novo. Depois manda
+ * faixas de linhas até ORCAMENTO_ENVIO bytes neste frame, e cada envio que
+ * termina troca a textura das suas faces. As faces trocadas (inclusive as
+ * atendidas direto pelo cache) são devolvidas em 'prontas' para o chamador
+ * avisar o Lua. Precisa ser chamada com o contexto GL atual, uma vez por
+ * frame.
+ */
+void Cubo::processarCarregamentos(std::vector<FotoCarregada>& prontas) {
+    TRACE_SCOPE("Cubo::processarCarregamentos");
+    prontas.clear();
+    prontas.swap(fotosDoCache);
+    ImagemCarregada carregada;
+    while (carregador.retirarConcluido(carregada)) {
+        int face = carregada.face;
+        if (!carregada.ok) {
+            std::cerr << "Falha ao carregar imagem: " << carregada.caminho << std::endl;
+            continue;
+        }
+
+        GLuint texId = texturas.adquirir(carregada.chave);
+        if (texId != 0) {
+            trocarTexturaFace(face, texId);
+            prontas.push_back({face, carregada.caminho});
+            continue;
+        }
+        auto igual = std::find_if(envios.begin(), envios.end(), [&carregada](const EnvioTextura& e) {
+            return e.carregada.chave == carregada.chave;
+        });
+        if (igual != envios.end()) {
+            igual->destinos.push_back({face, carregada.caminho});
+            continue;
+        }
+        GLuint nova = criarTextura(carregada.imagem);
+        FotoCarregada destino = {face, carregada.caminho};
+        envios.push_back({std::move(carregada), nova, 0, {destino}});
+    }
+
+    size_t orcamento = ORCAMENTO_ENVIO;
+    while (!envios.empty() && orcamento > 0) {
+        EnvioTextura& envio = envios.front();
+        if (!enviarFaixa(envio, orcamento)) break;
+
+        // a primeira face fica com a referência do registro; as outras
+        // adquirem a sua
+        texturas.registrar(envio.carregada.chave, envio.texId);
+        for (size_t i = 0; i < envio.destinos.size(); ++i) {
+            if (i > 0) texturas.adquirir(envio.carregada.chave);
+            trocarTexturaFace(envio.destinos[i].face, envio.texId);
+            prontas.push_back(envio.destinos[i]);
+        }
+        envios.pop_front();
+    }
+}
+
+bool Cubo::obterInfoTexturaFace(int face, InfoTextura& out) const {
+    if (face < 0 || face >= 6) return false;
+    return texturas.info(texturasFaces[face], out);
+}
+
+/*
+ * Memória de CPU usada só para levar fotos à GPU: o pixel buffer object
+ * (que fica alocado entre uploads), as imagens decodificadas que ainda
+ * esperam na fila e as que estão sendo enviadas em faixas.
+ */
+size_t Cubo::bytesStagingTexturas() const {
+    size_t emEnvio = 0;
+    for (const EnvioTextura& envio : envios) emEnvio += envio.carregada.imagem.pixels.size();
+    return bytesPbo + carregador.bytesProntos() + emEnvio;
 }
 
 void Cubo::definirEscalaTexturaFace(int face, float s) {
@@ -6,31 +6,99 @@
  * opcional, escala de textura e rotação de textura. A rotação do cubo inteiro
  * é acumulada em graus nos três eixos.
  *
- * A seleção de face é feita por color picking: o cubo é desenhado com uma cor
- * única por face em lerPixelPicking, e a resolução do pixel para índice de face
- * fica com o Lua (bridge.resolverFacePicking).
+ * A geometria fica retida em um VBO: posição, cor e UV de cada face só são
+ * regravados quando a cor da face muda, e não reconstruídos a cada frame.
+ * Escala e rotação de textura são uniforms do shader das faces.
+ *
+ * A seleção de face é feita por picking analítico na CPU: lancarRaioPicking
+ * cruza o raio do clique com o cubo girado e devolve o identificador da face,
+ * e a conversão do identificador para índice de face fica com o Lua
+ * (bridge.resolverFacePicking).
+ *
+ * As fotos das faces são carregadas fora da thread do GLUT: o pedido vai
+ * para o CarregadorImagens e o upload acontece em processarCarregamentos,
+ * por um pixel buffer object, em faixas de linhas espalhadas por alguns
+ * frames. Até a última faixa chegar a face continua como estava. As
+ * texturas ficam no GerenciadorTexturas, e faces com a mesma foto dividem
+ * uma textura só.
  */
 
 #ifndef CUBO_H
 #define CUBO_H
 
 #include <GL/glut.h>
+#include <deque>
 #include <string>
+#include <vector>
+#include "carregador_imagens.h"
+#include "gerenciador_texturas.h"
 
 struct Cor {
     float vermelho, verde, azul;
 };
 
+/*
+ * Resultado de lancarRaioPicking. id vale 1–6 para as faces 0–5 e 0 quando
+ * o raio não acerta o cubo; u e v são a posição do ponto atingido na face,
+ * de 0 a 1 a partir do primeiro vértice; distancia é medida do olho até o
+ * ponto, em unidades da cena.
+ */
+struct ResultadoPicking {
+    int   id;
+    float u, v;
+    float distancia;
+};
+
+/*
+ * Foto que terminou de carregar e já virou textura; main repassa ao Lua.
+ */
+struct FotoCarregada {
+    int         face;
+    std::string caminho;
+};
+
 class Cubo {
 private:
     float rotacaoX, rotacaoY, rotacaoZ;
     Cor coresFaces[6];
     int faceSelecionada;
+    int faceDestacada;
     GLuint texturasFaces[6];
-    bool texturasFacesTemAlfa[6];
     float escalasTexturasFaces[6];
     int   rotacoesTexturasFaces[6];
 
+    GLuint vboFaces;
+    bool   facesSujas[6];
+    GLuint programaFaces;
+    GLint  uniformEscala;
+    GLint  uniformRotacao;
+
+    CarregadorImagens   carregador;
+    GerenciadorTexturas texturas;
+    GLuint pboUpload;
+    size_t bytesPbo;
+    std::vector<FotoCarregada> fotosDoCache;
+
+    /*
+     * Foto decodificada a caminho da GPU. A textura já existe (sem pixels)
+     * e recebe as linhas a partir de proximaLinha; só vai para as faces de
+     * 'destinos' quando a última faixa chega.
+     */
+    struct EnvioTextura {
+        ImagemCarregada            carregada;
+        GLuint                     texId;
+        int                        proximaLinha;
+        std::vector<FotoCarregada> destinos;
+    };
+    std::deque<EnvioTextura> envios;
+
+    void marcarFaceSuja(int face) { if (face >= 0 && face < 6) facesSujas[face] = true; }
+    void atualizarGeometria();
+    GLuint criarTextura(const ImagemDecodificada& imagem);
+    bool   enviarFaixa(EnvioTextura& envio, size_t& orcamento);
+    void   descartarEnvios(int face);
+    void   trocarTexturaFace(int face, GLuint texId);
+
 public:
     Cubo();
     void renderizar();
@@ -38,12 +106,17 @@ public:
     void definirRotacao(float x, float y, float z);
     void limparFaceSelecionada();
     void limparCorFaceSelecionada();
-    int  lerPixelPicking(int x, int y);
+    ResultadoPicking lancarRaioPicking(int x, int y) const;
     void definirFaceSelecionada(int face);
+    bool definirFaceDestacada(int face);
     int obterFaceSelecionada() const { return faceSelecionada; }
     Cor obterCorFace(int face) const { return coresFaces[face]; }
     void definirCorFace(int face, float r, float g, float b);
     bool definirFotoFaceDeArquivo(int face, const std::string& path);
+    void processarCarregamentos(std::vector<FotoCarregada>& prontas);
+    const GerenciadorTexturas& obterTexturas() const { return texturas; }
+    bool   obterInfoTexturaFace(int face, InfoTextura& out) const;
+    size_t bytesStagingTexturas() const;
     bool  faceTemTextura(int face) const { return face>=0&&face<6&&texturasFaces[face]!=0; }
     float obterEscalaTexturaFace(int face) const { return (face>=0&&face<6)?escalasTexturasFaces[face]:1.0f; }
     void  definirEscalaTexturaFace(int face, float s);
@@ -0,0 +1,191 @@
+/*
+ * entrada_gravada.cpp
+ *
+ * Leitura e escrita do log binário de entrada.
+ */
+
+#include "entrada_gravada.h"
+#include <cstring>
+#include <iostream>
+
+static const char    MAGICA[7] = {'C', 'U', 'B', 'O', 'E', 'N', 'T'};
+static const uint8_t VERSAO    = 1;
+
+static void escreverU8(FILE* f, uint8_t v) { fputc(v, f); }
+
+static void escreverU16(FILE* f, uint16_t v) {
+    fputc(v & 0xFF, f);
+    fputc(v >> 8, f);
+}
+
+static void escreverI16(FILE* f, int v) {
+    if (v < -32768) v = -32768;
+    if (v >  32767) v =  32767;
+    escreverU16(f, (uint16_t)(int16_t)v);
+}
+
+static void escreverU32(FILE* f, uint32_t v) {
+    for (int i = 0; i < 4; ++i) fputc((v >> (8 * i)) & 0xFF, f);
+}
+
+/*
+ * Leitor sobre o conteúdo já carregado; 'ok' vira false ao passar do fim.
+ */
+struct Leitor {
+    const std::vector<unsigned char>& dados;
+    size_t pos;
+    bool   ok;
+
+    uint8_t u8() {
+        if (pos + 1 > dados.size()) { ok = false; return 0; }
+        return dados[pos++];
+    }
+    uint16_t u16() {
+        uint16_t lo = u8();
+        uint16_t hi = u8();
+        return (uint16_t)(lo | (hi << 8));
+    }
+    int i16() { return (int16_t)u16(); }
+    uint32_t u32() {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) v |= (uint32_t)u8() << (8 * i);
+        return v;
+    }
+};
+
+bool GravadorEntrada::abrir(const std::string& caminho) {
+    fechar();
+    arquivo = fopen(caminho.c_str(), "wb");
+    if (!arquivo) {
+        std::cerr << "Não foi possível gravar a entrada em " << caminho << std::endl;
+        return false;
+    }
+    fwrite(MAGICA, 1, sizeof(MAGICA), arquivo);
+    escreverU8(arquivo, VERSAO);
+    return true;
+}
+
+void GravadorEntrada::fechar() {
+    if (arquivo) fclose(arquivo);
+    arquivo = nullptr;
+}
+
+void GravadorEntrada::escreverCabecalho(uint32_t frame, uint8_t tipo) {
+    escreverU32(arquivo, frame);
+    escreverU8(arquivo, tipo);
+}
+
+void GravadorEntrada::tecla(uint32_t frame, unsigned char key, int x, int y) {
+    if (!arquivo) return;
+    escreverCabecalho(frame, EVENTO_TECLA);
+    escreverU8(arquivo, key);
+    escreverI16(arquivo, x);
+    escreverI16(arquivo, y);
+}
+
+void GravadorEntrada::especial(uint32_t frame, int key, int x, int y) {
+    if (!arquivo) return;
+    escreverCabecalho(frame, EVENTO_ESPECIAL);
+    escreverI16(arquivo, key);
+    escreverI16(arquivo, x);
+    escreverI16(arquivo, y);
+}
+
+void GravadorEntrada::mouse(uint32_t frame, int button, int state, int x, int y) {
+    if (!arquivo) return;
+    escreverCabecalho(frame, EVENTO_MOUSE);
+    escreverU8(arquivo, (uint8_t)button);
+    escreverU8(arquivo, (uint8_t)state);
+    escreverI16(arquivo, x);
+    escreverI16(arquivo, y);
+}
+
+void GravadorEntrada::movimento(uint32_t frame, int x, int y) {
+    if (!arquivo) return;
+    escreverCabecalho(frame, EVENTO_MOVIMENTO);
+    escreverI16(arquivo, x);
+    escreverI16(arquivo, y);
+}
+
+void GravadorEntrada::tamanho(uint32_t frame, int w, int h) {
+    if (!arquivo) return;
+    escreverCabecalho(frame, EVENTO_TAMANHO);
+    escreverI16(arquivo, w);
+    escreverI16(arquivo, h);
+}
+
+void GravadorEntrada::foto(uint32_t frame, int face, const std::string& caminho) {
+    if (!arquivo) return;
+    size_t n = caminho.size() > 0xFFFF ? 0xFFFF : caminho.size();
+    escreverCabecalho(frame, EVENTO_FOTO);
+    escreverU8(arquivo, (uint8_t)face);
+    escreverU16(arquivo, (uint16_t)n);
+    fwrite(caminho.data(), 1, n, arquivo);
+}
+
+bool ReprodutorEntrada::carregar(const std::string& caminho) {
+    FILE* f = fopen(caminho.c_str(), "rb");
+    if (!f) {
+        std::cerr << "Log de entrada não encontrado: " << caminho << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> dados;
+    unsigned char bloco[4096];
+    size_t lidos;
+    while ((lidos = fread(bloco, 1, sizeof(bloco), f)) > 0)
+        dados.insert(dados.end(), bloco, bloco + lidos);
+    fclose(f);
+
+    if (dados.size() < sizeof(MAGICA) + 1 || std::memcmp(dados.data(), MAGICA, sizeof(MAGICA)) != 0
+        || dados[sizeof(MAGICA)] != VERSAO) {
+        std::cerr << "Log de entrada inválido: " << caminho << std::endl;
+        return false;
+    }
+
+    Leitor l{dados, sizeof(MAGICA) + 1, true};
+    eventos.clear();
+    while (l.ok && l.pos < dados.size()) {
+        EventoEntrada e{};
+        e.frame = l.u32();
+        e.tipo  = l.u8();
+        switch (e.tipo) {
+            case EVENTO_TECLA:     e.a = l.u8();  e.b = l.i16(); e.c = l.i16(); break;
+            case EVENTO_ESPECIAL:  e.a = l.i16(); e.b = l.i16(); e.c = l.i16(); break;
+            case EVENTO_MOUSE:     e.a = l.u8();  e.b = l.u8();  e.c = l.i16(); e.d = l.i16(); break;
+            case EVENTO_MOVIMENTO: e.a = l.i16(); e.b = l.i16(); break;
+            case EVENTO_TAMANHO:   e.a = l.i16(); e.b = l.i16(); break;
+            case EVENTO_FOTO: {
+                e.a = l.u8();
+                uint16_t n = l.u16();
+                if (l.pos + n > dados.size()) { l.ok = false; break; }
+                e.caminho.assign((const char*)dados.data() + l.pos, n);
+                l.pos += n;
+                break;
+            }
+            default:
+                l.ok = false;
+        }
+        if (l.ok) eventos.push_back(std::move(e));
+    }
+    if (!l.ok) {
+        std::cerr << "Log de entrada truncado em " << caminho << "; usando "
+                  << eventos.size() << " eventos" << std::endl;
+    }
+    proximo = 0;
+    ativo   = true;
+    return true;
+}
+
+void ReprodutorEntrada::despachar(uint32_t frame, const AlvosEntrada& alvos) {
+    while (proximo < eventos.size() && eventos[proximo].frame <= frame) {
+        const EventoEntrada& e = eventos[proximo++];
+        switch (e.tipo) {
+            case EVENTO_TECLA:     alvos.tecla((unsigned char)e.a, e.b, e.c); break;
+            case EVENTO_ESPECIAL:  alvos.especial(e.a, e.b, e.c);            break;
+            case EVENTO_MOUSE:     alvos.mouse(e.a, e.b, e.c, e.d);          break;
+            case EVENTO_MOVIMENTO: alvos.movimento(e.a, e.b);                break;
+            case EVENTO_TAMANHO:   alvos.tamanho(e.a, e.b);                  break;
+            case EVENTO_FOTO:      alvos.foto(e.a, e.caminho);               break;
+        }
+    }
+}
@@ -0,0 +1,98 @@
+/*
+ * entrada_gravada.h
+ *
+ * Gravação e reprodução da entrada do usuário para cenários de benchmark
+ * repetíveis. Cada evento de teclado, teclas especiais, mouse, movimento,
+ * redimensionamento e foto escolhida é gravado com o número do frame do
+ * Relogio em que deve ser aplicado, num log binário compacto. Na
+ * reprodução, os eventos de cada frame são entregues aos mesmos callbacks
+ * antes do frame ser desenhado; com o relógio em passo fixo a execução se
+ * repete exatamente.
+ *
+ * Formato: "CUBOENT" + versão (1 byte), depois eventos com frame (u32),
+ * tipo (u8) e os campos do tipo, todos little-endian. Coordenadas são i16.
+ */
+
+#ifndef ENTRADA_GRAVADA_H
+#define ENTRADA_GRAVADA_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum TipoEvento : uint8_t {
+    EVENTO_TECLA     = 1,
+    EVENTO_ESPECIAL  = 2,
+    EVENTO_MOUSE     = 3,
+    EVENTO_MOVIMENTO = 4,
+    EVENTO_TAMANHO   = 5,
+    EVENTO_FOTO      = 6
+};
+
+struct EventoEntrada {
+    uint32_t frame;
+    uint8_t  tipo;
+    int32_t  a, b, c, d;
+    std::string caminho;
+};
+
+/*
+ * Para onde a reprodução entrega cada tipo de evento. São os mesmos
+ * callbacks registrados no GLUT, mais o que aplica uma foto sem abrir o
+ * seletor de arquivos.
+ */
+struct AlvosEntrada {
+    void (*tecla)(unsigned char key, int x, int y);
+    void (*especial)(int key, int x, int y);
+    void (*mouse)(int button, int state, int x, int y);
+    void (*movimento)(int x, int y);
+    void (*tamanho)(int w, int h);
+    void (*foto)(int face, const std::string& caminho);
+};
+
+class GravadorEntrada {
+private:
+    FILE* arquivo = nullptr;
+
+    void escreverCabecalho(uint32_t frame, uint8_t tipo);
+
+public:
+    ~GravadorEntrada() { fechar(); }
+
+    bool abrir(const std::string& caminho);
+    void fechar();
+    bool gravando() const { return arquivo != nullptr; }
+
+    void tecla(uint32_t frame, unsigned char key, int x, int y);
+    void especial(uint32_t frame, int key, int x, int y);
+    void mouse(uint32_t frame, int button, int state, int x, int y);
+    void movimento(uint32_t frame, int x, int y);
+    void tamanho(uint32_t frame, int w, int h);
+    void foto(uint32_t frame, int face, const std::string& caminho);
+};
+
+class ReprodutorEntrada {
+private:
+    std::vector<EventoEntrada> eventos;
+    size_t proximo = 0;
+    bool   ativo   = false;
+
+public:
+    /*
+     * Lê o log inteiro para a memória. Retorna false se o arquivo não abrir
+     * ou não tiver o cabeçalho esperado.
+     */
+    bool carregar(const std::string& caminho);
+
+    bool reproduzindo() const { return ativo; }
+    bool terminou() const { return proximo >= eventos.size(); }
+    uint32_t ultimoFrame() const { return eventos.empty() ? 0 : eventos.back().frame; }
+
+    /*
+     * Entrega, na ordem gravada, todos os eventos com frame <= 'frame'.
+     */
+    void despachar(uint32_t frame, const AlvosEntrada& alvos);
+};
+
+#endif
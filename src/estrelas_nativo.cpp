@@ -0,0 +1,381 @@
+/*
+ * estrelas_nativo.cpp
+ *
+ * Implementa o campo de estrelas em C++. A conta é a mesma de
+ * obterPosicoesEstrelas em background.lua; a única diferença é que os dois
+ * senos por estrela são reescritos pela soma de ângulos:
+ *
+ *   sin(a + fase) = sin(a) * cos(fase) + cos(a) * sin(fase)
+ *
+ * sin(a) e cos(a) dependem só do tempo e são calculados uma vez por frame;
+ * sin(fase) e cos(fase) dependem só da estrela e são calculados uma vez em
+ * inicializar(). Assim o laço por estrela fica só com multiplicações, somas
+ * e floor, que vetorizam direto em SSE2 e AVX2.
+ */
+
+#include "estrelas_nativo.h"
+#include "pool_tarefas.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #include <immintrin.h>
+    #define ESTRELAS_X86 1
+#else
+    #define ESTRELAS_X86 0
+#endif
+
+namespace {
+
+const double TWO_PI = 2.0 * M_PI;
+
+/*
+ * valores que dependem só do tempo, calculados uma vez por frame em double
+ * como o Lua faz e passados aos kernels já em float.
+ */
+struct ConstantesFrame {
+    float tempo;
+    float cossenoAngulo, senoAngulo;
+    float senoDesvio, cossenoDesvio;
+    float senoCintilar, cossenoCintilar;
+};
+
+struct DadosEstrelas {
+    const float* x;
+    const float* y;
+    const float* velocidade;
+    const float* brilho;
+    const float* senoFase;
+    const float* cossenoFase;
+};
+
+using KernelEstrelas = void (*)(const DadosEstrelas&, int, int, const ConstantesFrame&, float*);
+
+void calcularEscalar(const DadosEstrelas& d, int ini, int fim, const ConstantesFrame& k, float* out) {
+    for (int i = ini; i < fim; ++i) {
+        float deslocamento = k.tempo * d.velocidade[i];
+        float yDerivado = d.y[i] - (deslocamento - std::floor(deslocamento));
+        if (yDerivado < 0.0f) yDerivado += 1.0f;
+
+        float desvio = (k.senoDesvio * d.cossenoFase[i] + k.cossenoDesvio * d.senoFase[i]) * 0.01f;
+        float xDerivado = d.x[i] + desvio;
+
+        float relativoX = xDerivado - 0.5f;
+        float relativoY = yDerivado - 0.5f;
+        float rotacionadoX = relativoX * k.cossenoAngulo - relativoY * k.senoAngulo + 0.5f;
+        float rotacionadoY = relativoX * k.senoAngulo + relativoY * k.cossenoAngulo + 0.5f;
+        rotacionadoX -= std::floor(rotacionadoX);
+        rotacionadoY -= std::floor(rotacionadoY);
+
+        float seno = k.senoCintilar * d.cossenoFase[i] + k.cossenoCintilar * d.senoFase[i];
+        float cintilacao = 0.35f + 0.65f * (0.5f + 0.5f * seno);
+        float brilhoFinal = d.brilho[i] * cintilacao;
+
+        float* o = out + static_cast<size_t>(i) * 5u;
+        o[0] = rotacionadoX;
+        o[1] = rotacionadoY;
+        o[2] = brilhoFinal * 0.85f;
+        o[3] = brilhoFinal * 0.90f;
+        o[4] = brilhoFinal;
+    }
+}
+
+#if ESTRELAS_X86
+
+/*
+ * floor em SSE2 puro: trunca, converte de volta e subtrai 1 onde o
+ * truncamento arredondou para cima (valores negativos). Vale para
+ * |v| < 2^31, bem acima de qualquer tempo * velocidade usado aqui.
+ */
+inline __m128 floorSse2(__m128 v) {
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), _mm_set1_ps(1.0f)));
+}
+
+/*
+ * grava os cinco campos de 'n' estrelas intercalados (x, y, r, g, b), que
+ * é o layout lido pelo renderizador.
+ */
+inline void intercalar(const float* px, const float* py, const float* pb, int n, float* out) {
+    for (int j = 0; j < n; ++j) {
+        out[j * 5 + 0] = px[j];
+        out[j * 5 + 1] = py[j];
+        out[j * 5 + 2] = pb[j] * 0.85f;
+        out[j * 5 + 3] = pb[j] * 0.90f;
+        out[j * 5 + 4] = pb[j];
+    }
+}
+
+void calcularSse2(const DadosEstrelas& d, int ini, int fim, const ConstantesFrame& k, float* out) {
+    const __m128 um      = _mm_set1_ps(1.0f);
+    const __m128 zero    = _mm_setzero_ps();
+    const __m128 meio    = _mm_set1_ps(0.5f);
+    const __m128 tempo   = _mm_set1_ps(k.tempo);
+    const __m128 cosA    = _mm_set1_ps(k.cossenoAngulo);
+    const __m128 sinA    = _mm_set1_ps(k.senoAngulo);
+    const __m128 sinD    = _mm_set1_ps(k.senoDesvio);
+    const __m128 cosD    = _mm_set1_ps(k.cossenoDesvio);
+    const __m128 sinC    = _mm_set1_ps(k.senoCintilar);
+    const __m128 cosC    = _mm_set1_ps(k.cossenoCintilar);
+    const __m128 escalaDesvio = _mm_set1_ps(0.01f);
+    const __m128 base    = _mm_set1_ps(0.35f);
+    const __m128 faixa   = _mm_set1_ps(0.65f);
+
+    alignas(16) float px[4], py[4], pb[4];
+    int i = ini;
+    for (; i + 4 <= fim; i += 4) {
+        __m128 deslocamento = _mm_mul_ps(tempo, _mm_loadu_ps(d.velocidade + i));
+        __m128 fracao = _mm_sub_ps(deslocamento, floorSse2(deslocamento));
+        __m128 yDerivado = _mm_sub_ps(_mm_loadu_ps(d.y + i), fracao);
+        yDerivado = _mm_add_ps(yDerivado, _mm_and_ps(_mm_cmplt_ps(yDerivado, zero), um));
+
+        __m128 sinF = _mm_loadu_ps(d.senoFase + i);
+        __m128 cosF = _mm_loadu_ps(d.cossenoFase + i);
+        __m128 desvio = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(sinD, cosF), _mm_mul_ps(cosD, sinF)), escalaDesvio);
+        __m128 xDerivado = _mm_add_ps(_mm_loadu_ps(d.x + i), desvio);
+
+        __m128 relativoX = _mm_sub_ps(xDerivado, meio);
+        __m128 relativoY = _mm_sub_ps(yDerivado, meio);
+        __m128 rotX = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(relativoX, cosA), _mm_mul_ps(relativoY, sinA)), meio);
+        __m128 rotY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(relativoX, sinA), _mm_mul_ps(relativoY, cosA)), meio);
+        rotX = _mm_sub_ps(rotX, floorSse2(rotX));
+        rotY = _mm_sub_ps(rotY, floorSse2(rotY));
+
+        __m128 seno = _mm_add_ps(_mm_mul_ps(sinC, cosF), _mm_mul_ps(cosC, sinF));
+        __m128 cintilacao = _mm_add_ps(base, _mm_mul_ps(faixa, _mm_add_ps(meio, _mm_mul_ps(meio, seno))));
+        __m128 brilhoFinal = _mm_mul_ps(_mm_loadu_ps(d.brilho + i), cintilacao);
+
+        _mm_store_ps(px, rotX);
+        _mm_store_ps(py, rotY);
+        _mm_store_ps(pb, brilhoFinal);
+        intercalar(px, py, pb, 4, out + static_cast<size_t>(i) * 5u);
+    }
+    calcularEscalar(d, i, fim, k, out);
+}
+
+__attribute__((target("avx2")))
+void calcularAvx2(const DadosEstrelas& d, int ini, int fim, const ConstantesFrame& k, float* out) {
+    const __m256 um      = _mm256_set1_ps(1.0f);
+    const __m256 zero    = _mm256_setzero_ps();
+    const __m256 meio    = _mm256_set1_ps(0.5f);
+    const __m256 tempo   = _mm256_set1_ps(k.tempo);
+    const __m256 cosA    = _mm256_set1_ps(k.cossenoAngulo);
+    const __m256 sinA    = _mm256_set1_ps(k.senoAngulo);
+    const __m256 sinD    = _mm256_set1_ps(k.senoDesvio);
+    const __m256 cosD    = _mm256_set1_ps(k.cossenoDesvio);
+    const __m256 sinC    = _mm256_set1_ps(k.senoCintilar);
+    const __m256 cosC    = _mm256_set1_ps(k.cossenoCintilar);
+    const __m256 escalaDesvio = _mm256_set1_ps(0.01f);
+    const __m256 base    = _mm256_set1_ps(0.35f);
+    const __m256 faixa   = _mm256_set1_ps(0.65f);
+
+    alignas(32) float px[8], py[8], pb[8];
+    int i = ini;
+    for (; i + 8 <= fim; i += 8) {
+        __m256 deslocamento = _mm256_mul_ps(tempo, _mm256_loadu_ps(d.velocidade + i));
+        __m256 fracao = _mm256_sub_ps(deslocamento, _mm256_floor_ps(deslocamento));
+        __m256 yDerivado = _mm256_sub_ps(_mm256_loadu_ps(d.y + i), fracao);
+        yDerivado = _mm256_add_ps(yDerivado, _mm256_and_ps(_mm256_cmp_ps(yDerivado, zero, _CMP_LT_OQ), um));
+
+        __m256 sinF = _mm256_loadu_ps(d.senoFase + i);
+        __m256 cosF = _mm256_loadu_ps(d.cossenoFase + i);
+        __m256 desvio = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(sinD, cosF), _mm256_mul_ps(cosD, sinF)), escalaDesvio);
+        __m256 xDerivado = _mm256_add_ps(_mm256_loadu_ps(d.x + i), desvio);
+
+        __m256 relativoX = _mm256_sub_ps(xDerivado, meio);
+        __m256 relativoY = _mm256_sub_ps(yDerivado, meio);
+        __m256 rotX = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(relativoX, cosA), _mm256_mul_ps(relativoY, sinA)), meio);
+        __m256 rotY = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(relativoX, sinA), _mm256_mul_ps(relativoY, cosA)), meio);
+        rotX = _mm256_sub_ps(rotX, _mm256_floor_ps(rotX));
+        rotY = _mm256_sub_ps(rotY, _mm256_floor_ps(rotY));
+
+        __m256 seno = _mm256_add_ps(_mm256_mul_ps(sinC, cosF), _mm256_mul_ps(cosC, sinF));
+        __m256 cintilacao = _mm256_add_ps(base, _mm256_mul_ps(faixa, _mm256_add_ps(meio, _mm256_mul_ps(meio, seno))));
+        __m256 brilhoFinal = _mm256_mul_ps(_mm256_loadu_ps(d.brilho + i), cintilacao);
+
+        _mm256_store_ps(px, rotX);
+        _mm256_store_ps(py, rotY);
+        _mm256_store_ps(pb, brilhoFinal);
+        intercalar(px, py, pb, 8, out + static_cast<size_t>(i) * 5u);
+    }
+    calcularEscalar(d, i, fim, k, out);
+}
+
+#endif
+
+struct Despacho {
+    KernelEstrelas kernel;
+    const char*    nome;
+};
+
+/*
+ * todos os kernels que rodam nesta CPU, do mais largo para o escalar.
+ * Fora de x86 sobra só o caminho escalar.
+ */
+const std::vector<Despacho>& kernelsDisponiveis() {
+    static const std::vector<Despacho> lista = []() {
+        std::vector<Despacho> l;
+#if ESTRELAS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) l.push_back({calcularAvx2, "avx2"});
+        l.push_back({calcularSse2, "sse2"});
+#endif
+        l.push_back({calcularEscalar, "escalar"});
+        return l;
+    }();
+    return lista;
+}
+
+/*
+ * escolhe o kernel uma única vez, na primeira chamada: o mais largo que a
+ * CPU suporta. O escalar só é usado sozinho fora de x86.
+ */
+const Despacho& despacho() {
+    return kernelsDisponiveis().front();
+}
+
+const Despacho* buscarKernel(const char* nome) {
+    for (const Despacho& d : kernelsDisponiveis())
+        if (std::strcmp(d.nome, nome) == 0) return &d;
+    return nullptr;
+}
+
+}
+
+namespace {
+
+const uint32_t LCG_SEMENTE        = 1337u;
+const uint32_t LCG_MULTIPLICADOR  = 1664525u;
+const uint32_t LCG_INCREMENTO     = 1013904223u;
+const int      SORTEIOS_POR_ESTRELA = 4;
+
+/*
+ * estado do LCG depois de 'passos' sorteios a partir da semente, em
+ * O(log passos): um passo é o mapa afim s -> a*s + c (mod 2^32), e o mapa
+ * de 2k passos é o de k passos composto com ele mesmo.
+ */
+uint32_t saltarLCG(uint64_t passos) {
+    uint32_t a = LCG_MULTIPLICADOR, c = LCG_INCREMENTO;   // mapa de 2^bit passos
+    uint32_t aTotal = 1, cTotal = 0;                       // mapa acumulado
+    while (passos) {
+        if (passos & 1) {
+            aTotal = a * aTotal;
+            cTotal = a * cTotal + c;
+        }
+        c = a * c + c;
+        a = a * a;
+        passos >>= 1;
+    }
+    return aTotal * LCG_SEMENTE + cTotal;
+}
+
+}
+
+/*
+ * Mesmo gerador de background.lua: estado de 32 bits, seed 1337, e a
+ * mesma ordem de sorteio (profundidade, x, y, cintilar) por estrela. O
+ * bloco começa no estado em que o laço sequencial estaria na estrela
+ * 'inicio'.
+ */
+void CampoEstrelas::gerarBloco(int inicio, int fim) {
+    uint32_t estadoLCG = saltarLCG((uint64_t)inicio * SORTEIOS_POR_ESTRELA);
+    auto aleatorio01 = [&estadoLCG]() -> double {
+        estadoLCG = estadoLCG * LCG_MULTIPLICADOR + LCG_INCREMENTO;
+        return (double)(estadoLCG & 0x00FFFFFFu) / 16777215.0;
+    };
+
+    for (int i = inicio; i < fim; ++i) {
+        double profundidade = aleatorio01();
+        x[i] = (float)aleatorio01();
+        y[i] = (float)aleatorio01();
+        velocidade[i] = (float)(0.02 + profundidade * 0.10);
+        brilho[i]     = (float)(0.45 + (1.0 - profundidade) * 0.55);
+        double fase   = aleatorio01() * 6.2831853;
+        cintilar[i]    = (float)fase;
+        senoFase[i]    = (float)std::sin(fase);
+        cossenoFase[i] = (float)std::cos(fase);
+    }
+}
+
+void CampoEstrelas::inicializar(int quantidade) {
+    TRACE_SCOPE("CampoEstrelas::inicializar");
+    if (quantidade < 0) quantidade = 0;
+    size_t n = static_cast<size_t>(quantidade);
+    x.resize(n); y.resize(n);
+    velocidade.resize(n); brilho.resize(n); cintilar.resize(n);
+    senoFase.resize(n); cossenoFase.resize(n);
+
+    if (!paralelo || quantidade < MINIMO_PARALELO) {
+        gerarBloco(0, quantidade);
+        return;
+    }
+    int blocos = (quantidade + TAMANHO_BLOCO - 1) / TAMANHO_BLOCO;
+    PoolTarefas::compartilhado().paraCada(blocos, [this, quantidade](int b) {
+        gerarBloco(b * TAMANHO_BLOCO, std::min(quantidade, (b + 1) * TAMANHO_BLOCO));
+    });
+}
+
+void CampoEstrelas::calcular(float tempo, std::vector<float>& out) const {
+    out.resize(x.size() * 5u);
+    if (x.empty()) return;
+
+    double t = tempo;
+    double angulo = t * (TWO_PI / 120.0);
+    ConstantesFrame k;
+    k.tempo           = tempo;
+    k.cossenoAngulo   = (float)std::cos(angulo);
+    k.senoAngulo      = (float)std::sin(angulo);
+    k.senoDesvio      = (float)std::sin(t * 0.15);
+    k.cossenoDesvio   = (float)std::cos(t * 0.15);
+    k.senoCintilar    = (float)std::sin(t * 2.0);
+    k.cossenoCintilar = (float)std::cos(t * 2.0);
+
+    DadosEstrelas d = {x.data(), y.data(), velocidade.data(), brilho.data(),
+                       senoFase.data(), cossenoFase.data()};
+    int n = (int)x.size();
+    KernelEstrelas kernel = caminhoForcado ? buscarKernel(caminhoForcado)->kernel : despacho().kernel;
+    if (!paralelo || n < MINIMO_PARALELO) {
+        kernel(d, 0, n, k, out.data());
+        return;
+    }
+    // cada bloco escreve só a sua fatia de 'out'
+    int blocos = (n + TAMANHO_BLOCO - 1) / TAMANHO_BLOCO;
+    float* saida = out.data();
+    PoolTarefas::compartilhado().paraCada(blocos, [&d, &k, kernel, saida, n](int b) {
+        TRACE_SCOPE("bloco de estrelas");
+        kernel(d, b * TAMANHO_BLOCO, std::min(n, (b + 1) * TAMANHO_BLOCO), k, saida);
+    });
+}
+
+void CampoEstrelas::copiarConstantes(std::vector<float>& out) const {
+    out.resize(x.size() * 5u);
+    for (size_t i = 0; i < x.size(); ++i) {
+        float* o = &out[i * 5u];
+        o[0] = x[i];
+        o[1] = y[i];
+        o[2] = velocidade[i];
+        o[3] = brilho[i];
+        o[4] = cintilar[i];
+    }
+}
+
+const char* CampoEstrelas::caminhoSimd() {
+    return despacho().nome;
+}
+
+bool CampoEstrelas::forcarCaminho(const char* nome) {
+    if (!nome) { caminhoForcado = nullptr; return true; }
+    const Despacho* d = buscarKernel(nome);
+    if (!d) return false;
+    caminhoForcado = d->nome;
+    return true;
+}
+
+std::vector<const char*> CampoEstrelas::caminhosDisponiveis() {
+    std::vector<const char*> nomes;
+    for (const Despacho& d : kernelsDisponiveis()) nomes.push_back(d.nome);
+    return nomes;
+}
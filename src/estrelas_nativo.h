@@ -0,0 +1,94 @@
+/*
+ * estrelas_nativo.h
+ *
+ * Versão em C++ do campo de estrelas de background.lua. Gera as mesmas
+ * estrelas (LCG com seed 1337) e calcula posição e cor com a mesma conta de
+ * obterPosicoesEstrelas: deriva para baixo, balanço em seno, rotação de
+ * 120 s, cintilação e o wrap com floor.
+ *
+ * Os dados ficam em estrutura de arrays (um vetor por campo) para que o
+ * cálculo rode em blocos SIMD. O caminho AVX2, SSE2 ou escalar é escolhido
+ * em tempo de execução conforme a CPU.
+ *
+ * Campos grandes são divididos em blocos de TAMANHO_BLOCO estrelas que o
+ * PoolTarefas compartilhado calcula em paralelo; cada bloco escreve a sua
+ * fatia do vetor de saída. Na geração, cada bloco pula o LCG direto para o
+ * estado da sua primeira estrela, então o resultado é o mesmo de uma
+ * thread só (e do Lua).
+ */
+
+#ifndef ESTRELAS_NATIVO_H
+#define ESTRELAS_NATIVO_H
+
+#include <vector>
+
+class CampoEstrelas {
+public:
+    /*
+     * Estrelas por bloco paralelo (múltiplo de 8, a largura do AVX2) e o
+     * tamanho a partir do qual o campo é dividido. Abaixo disso o custo de
+     * acordar o pool passa do ganho.
+     */
+    static constexpr int TAMANHO_BLOCO    = 32768;
+    static constexpr int MINIMO_PARALELO  = 2 * TAMANHO_BLOCO;
+
+private:
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> velocidade;
+    std::vector<float> brilho;
+    std::vector<float> cintilar;
+    std::vector<float> senoFase;
+    std::vector<float> cossenoFase;
+    bool paralelo = true;
+    const char* caminhoForcado = nullptr;
+
+    void gerarBloco(int inicio, int fim);
+
+public:
+    /*
+     * Recria as estrelas com o mesmo LCG de background.lua, na mesma ordem
+     * de sorteio, para que o resultado seja idêntico ao do Lua.
+     */
+    void inicializar(int quantidade);
+
+    /*
+     * Preenche 'out' com 5 floats por estrela (x, y, r, g, b) para o
+     * instante 'tempo', no mesmo layout que o Lua escreve no buffer.
+     */
+    void calcular(float tempo, std::vector<float>& out) const;
+
+    /*
+     * Usar ou não o pool nos campos grandes; ligado por padrão. Desligado,
+     * tudo roda na thread que chama, para comparar no bench.
+     */
+    void definirParalelo(bool ligado) { paralelo = ligado; }
+
+    /*
+     * Copia as constantes de cada estrela para 'out' em pacotes de 5 floats:
+     * x, y, velocidade, brilho e fase de cintilação. É o conteúdo do VBO
+     * estático do motor de GPU.
+     */
+    void copiarConstantes(std::vector<float>& out) const;
+
+    int quantidade() const { return (int)x.size(); }
+
+    /*
+     * Nome do caminho SIMD escolhido para esta CPU: "avx2", "sse2" ou "escalar".
+     */
+    static const char* caminhoSimd();
+
+    /*
+     * Força um caminho ("avx2", "sse2" ou "escalar") em vez do escolhido
+     * pela CPU; nullptr volta ao automático. Devolve false se o caminho não
+     * existe ou a CPU não o suporta. Serve para a verificação de paridade.
+     */
+    bool forcarCaminho(const char* nome);
+
+    /*
+     * Caminhos que rodam nesta CPU, do mais largo para o escalar.
+     */
+    static std::vector<const char*> caminhosDisponiveis();
+};
+
+#endif
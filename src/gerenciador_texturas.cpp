@@ -0,0 +1,111 @@
+/*
+ * gerenciador_texturas.cpp
+ *
+ * Contagem de referências das texturas das fotos. Todas as chamadas, menos
+ * chaveArquivo, precisam do contexto GL e rodam na thread do GLUT.
+ */
+
+#include "gerenciador_texturas.h"
+#include <sys/stat.h>
+
+bool GerenciadorTexturas::chaveArquivo(const std::string& caminho, std::string& chave) {
+    struct stat info;
+    if (stat(caminho.c_str(), &info) != 0) {
+        return false;
+    }
+    chave = caminho + '|' + std::to_string((long long)info.st_size)
+                    + '|' + std::to_string((long long)info.st_mtime);
+    return true;
+}
+
+GLuint GerenciadorTexturas::adquirir(const std::string& chave) {
+    auto it = porChave.find(chave);
+    if (it == porChave.end()) return 0;
+    ++entradas[it->second].refs;
+    return it->second;
+}
+
+/*
+ * Tamanho de um texel como a GPU o guarda: os drivers alinham o texel à
+ * próxima potência de dois, então RGB8 (24 bits) ocupa 32, como RGBA8, e
+ * RGB16 ocupa 64.
+ */
+static size_t bitsArmazenados(GLint bits) {
+    size_t b = 8;
+    while (b < (size_t)bits) b *= 2;
+    return b;
+}
+
+/*
+ * Consulta o driver nível a nível: bits por componente (incluindo
+ * luminância e intensidade), arredondados para o texel alinhado, vezes a
+ * área de cada nível. Assim os bytes seguem o formato interno que foi de
+ * fato alocado, e não o formato em que os pixels foram enviados.
+ */
+static InfoTextura consultarTextura(GLuint id) {
+    static const GLenum componentes[] = {
+        GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE,
+        GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_LUMINANCE_SIZE, GL_TEXTURE_INTENSITY_SIZE,
+    };
+
+    InfoTextura info = {0, 0, 0, 0, 0};
+    GLint anterior = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &anterior);
+    glBindTexture(GL_TEXTURE_2D, id);
+
+    GLint formato = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &formato);
+    info.formatoInterno = (GLenum)formato;
+
+    for (int nivel = 0; nivel < 32; ++nivel) {
+        GLint w = 0, h = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, nivel, GL_TEXTURE_WIDTH,  &w);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, nivel, GL_TEXTURE_HEIGHT, &h);
+        if (w <= 0 || h <= 0) break;
+
+        GLint bits = 0;
+        for (GLenum c : componentes) {
+            GLint b = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, nivel, c, &b);
+            bits += b;
+        }
+        if (nivel == 0) {
+            info.largura = w;
+            info.altura  = h;
+        }
+        info.bytes += (size_t)w * (size_t)h * bitsArmazenados(bits) / 8u;
+        ++info.niveis;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, (GLuint)anterior);
+    return info;
+}
+
+void GerenciadorTexturas::registrar(const std::string& chave, GLuint id) {
+    if (id == 0) return;
+    InfoTextura info = consultarTextura(id);
+    entradas[id] = {chave, info, 1};
+    porChave[chave] = id;
+    bytesTotais += info.bytes;
+}
+
+void GerenciadorTexturas::liberar(GLuint id) {
+    auto it = entradas.find(id);
+    if (it == entradas.end()) return;
+    if (--it->second.refs > 0) return;
+
+    auto chave = porChave.find(it->second.chave);
+    if (chave != porChave.end() && chave->second == id) {
+        porChave.erase(chave);
+    }
+    bytesTotais -= it->second.info.bytes;
+    entradas.erase(it);
+    glDeleteTextures(1, &id);
+}
+
+bool GerenciadorTexturas::info(GLuint id, InfoTextura& out) const {
+    auto it = entradas.find(id);
+    if (it == entradas.end()) return false;
+    out = it->second.info;
+    return true;
+}
@@ -0,0 +1,75 @@
+/*
+ * gerenciador_texturas.h
+ *
+ * Cache das texturas das fotos, endereçado pelo conteúdo do arquivo:
+ * caminho, tamanho em bytes e data de modificação. Faces que mostram a
+ * mesma imagem dividem uma única textura GL, com contagem de referências;
+ * a textura é apagada quando a última face a solta. O identificador GL da
+ * textura serve de handle.
+ */
+
+#ifndef GERENCIADOR_TEXTURAS_H
+#define GERENCIADOR_TEXTURAS_H
+
+#include <GL/gl.h>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+/*
+ * O que o driver diz ter alocado para uma textura: dimensões do nível 0,
+ * formato interno, quantidade de níveis de mipmap e a soma dos bytes de
+ * todos os níveis.
+ */
+struct InfoTextura {
+    int    largura;
+    int    altura;
+    GLenum formatoInterno;
+    int    niveis;
+    size_t bytes;
+};
+
+class GerenciadorTexturas {
+private:
+    struct Entrada {
+        std::string chave;
+        InfoTextura info;
+        int         refs;
+    };
+
+    std::unordered_map<GLuint, Entrada>      entradas;
+    std::unordered_map<std::string, GLuint>  porChave;
+    size_t bytesTotais = 0;
+
+public:
+    /*
+     * Monta a chave do arquivo a partir de stat(): caminho, tamanho e mtime.
+     * Retorna false se o arquivo não existe. Não usa GL; pode rodar em
+     * qualquer thread.
+     */
+    static bool chaveArquivo(const std::string& caminho, std::string& chave);
+
+    /*
+     * Procura uma textura já residente com essa chave. Se achar, soma uma
+     * referência e devolve o id; senão devolve 0.
+     */
+    GLuint adquirir(const std::string& chave);
+
+    /*
+     * Passa a controlar uma textura recém-criada, já com uma referência.
+     * Dimensões, formato e níveis são lidos do próprio GL nesse momento.
+     */
+    void registrar(const std::string& chave, GLuint id);
+
+    /*
+     * Solta uma referência; na última, chama glDeleteTextures. Ids que não
+     * pertencem ao gerenciador (ou 0) são ignorados.
+     */
+    void liberar(GLuint id);
+
+    bool   info(GLuint id, InfoTextura& out) const;
+    int    quantidade() const { return (int)entradas.size(); }
+    size_t bytesResidentes() const { return bytesTotais; }
+};
+
+#endif
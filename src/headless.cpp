@@ -0,0 +1,214 @@
+/*
+ * headless.cpp
+ *
+ * Criação do contexto EGL fora da tela e relatório dos frames medidos.
+ */
+
+#include "headless.h"
+#include <GL/gl.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#if __has_include(<EGL/egl.h>)
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+    #define HAS_EGL 1
+#else
+    #define HAS_EGL 0
+#endif
+
+#if HAS_EGL
+static EGLDisplay displayEgl   = EGL_NO_DISPLAY;
+static EGLContext contextoEgl  = EGL_NO_CONTEXT;
+static EGLSurface superficieEgl = EGL_NO_SURFACE;
+static GLuint     fboHeadless  = 0;
+static GLuint     rboCor       = 0;
+static GLuint     rboProfundidade = 0;
+
+/*
+ * Prefere a plataforma surfaceless do Mesa (não precisa de X nem de
+ * /dev/dri); sem ela, cai no display padrão do EGL.
+ */
+static EGLDisplay abrirDisplay() {
+    const char* extensoes = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (extensoes && strstr(extensoes, "EGL_MESA_platform_surfaceless")) {
+        auto obterDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (obterDisplay) {
+            EGLDisplay d = obterDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (d != EGL_NO_DISPLAY) return d;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+/*
+ * Framebuffer object com cor RGBA8 e profundidade de 24 bits, para quando
+ * o contexto não tem superfície.
+ */
+static bool criarFbo(int largura, int altura) {
+    glGenFramebuffers(1, &fboHeadless);
+    glGenRenderbuffers(1, &rboCor);
+    glGenRenderbuffers(1, &rboProfundidade);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, rboCor);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, largura, altura);
+    glBindRenderbuffer(GL_RENDERBUFFER, rboProfundidade);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, largura, altura);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fboHeadless);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rboCor);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, rboProfundidade);
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+#endif
+
+bool criarContextoHeadless(int largura, int altura) {
+#if HAS_EGL
+    displayEgl = abrirDisplay();
+    EGLint major = 0, minor = 0;
+    if (displayEgl == EGL_NO_DISPLAY || !eglInitialize(displayEgl, &major, &minor)) {
+        std::cerr << "Headless: EGL indisponível" << std::endl;
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "Headless: EGL sem suporte a OpenGL desktop" << std::endl;
+        return false;
+    }
+
+    const EGLint atributos[] = {
+        EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    const EGLint atributosSemSuperficie[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint quantos = 0;
+    bool usarPbuffer = eglChooseConfig(displayEgl, atributos, &config, 1, &quantos) && quantos > 0;
+    if (!usarPbuffer &&
+        !(eglChooseConfig(displayEgl, atributosSemSuperficie, &config, 1, &quantos) && quantos > 0)) {
+        std::cerr << "Headless: nenhuma configuração EGL com OpenGL" << std::endl;
+        return false;
+    }
+
+    contextoEgl = eglCreateContext(displayEgl, config, EGL_NO_CONTEXT, nullptr);
+    if (contextoEgl == EGL_NO_CONTEXT) {
+        std::cerr << "Headless: falha ao criar contexto EGL" << std::endl;
+        return false;
+    }
+
+    if (usarPbuffer) {
+        const EGLint tamanho[] = {EGL_WIDTH, largura, EGL_HEIGHT, altura, EGL_NONE};
+        superficieEgl = eglCreatePbufferSurface(displayEgl, config, tamanho);
+    }
+    if (!eglMakeCurrent(displayEgl, superficieEgl, superficieEgl, contextoEgl)) {
+        std::cerr << "Headless: falha ao ativar o contexto EGL" << std::endl;
+        return false;
+    }
+    if (superficieEgl == EGL_NO_SURFACE && !criarFbo(largura, altura)) {
+        std::cerr << "Headless: framebuffer fora da tela incompleto" << std::endl;
+        return false;
+    }
+    return true;
+#else
+    (void)largura; (void)altura;
+    std::cerr << "Headless: compilado sem EGL" << std::endl;
+    return false;
+#endif
+}
+
+void trocarBuffersHeadless() {
+    glFinish();
+}
+
+void encerrarContextoHeadless() {
+#if HAS_EGL
+    if (fboHeadless) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fboHeadless);
+        glDeleteRenderbuffers(1, &rboCor);
+        glDeleteRenderbuffers(1, &rboProfundidade);
+        fboHeadless = 0;
+    }
+    if (displayEgl != EGL_NO_DISPLAY) {
+        eglMakeCurrent(displayEgl, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (superficieEgl != EGL_NO_SURFACE) eglDestroySurface(displayEgl, superficieEgl);
+        if (contextoEgl != EGL_NO_CONTEXT)   eglDestroyContext(displayEgl, contextoEgl);
+        eglTerminate(displayEgl);
+    }
+    displayEgl    = EGL_NO_DISPLAY;
+    contextoEgl   = EGL_NO_CONTEXT;
+    superficieEgl = EGL_NO_SURFACE;
+#endif
+}
+
+/*
+ * Percentil pelo método do posto mais próximo sobre os tempos ordenados.
+ */
+static double percentil(const std::vector<double>& ordenados, double p) {
+    if (ordenados.empty()) return 0.0;
+    size_t posto = (size_t)(p / 100.0 * ordenados.size() + 0.999999);
+    if (posto < 1) posto = 1;
+    if (posto > ordenados.size()) posto = ordenados.size();
+    return ordenados[posto - 1];
+}
+
+uint64_t hashFramebuffer(int largura, int altura, std::vector<unsigned char>& pixels) {
+    pixels.resize((size_t)largura * (size_t)altura * 4u);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, largura, altura, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : pixels) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+void imprimirEstatisticasJson(std::ostream& out, const RelatorioHeadless& relatorio) {
+    const std::vector<double>& temposMs = relatorio.temposMs;
+    std::vector<double> ordenados(temposMs);
+    std::sort(ordenados.begin(), ordenados.end());
+    double total = 0.0;
+    for (double t : temposMs) total += t;
+    double media = temposMs.empty() ? 0.0 : total / temposMs.size();
+
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "{\"largura\":%d,\"altura\":%d,\"frames\":%zu,\"total_ms\":%.3f,\"fps\":%.2f,"
+             "\"frame_ms\":{\"media\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f},",
+             relatorio.largura, relatorio.altura, temposMs.size(), total, total > 0.0 ? temposMs.size() * 1000.0 / total : 0.0,
+             media, percentil(ordenados, 50.0), percentil(ordenados, 95.0),
+             percentil(ordenados, 99.0), ordenados.empty() ? 0.0 : ordenados.back());
+    out << buf;
+    snprintf(buf, sizeof(buf), "\"relogio\":{\"modo\":\"%s\",\"passo_s\":%.9g},",
+             relatorio.modoRelogio.c_str(), relatorio.passoRelogio);
+    out << buf;
+    snprintf(buf, sizeof(buf), "\"estrelas\":{\"quantidade\":%d,\"motor\":\"%s\",\"threads\":%d},",
+             relatorio.estrelas, relatorio.motorEstrelas.c_str(), relatorio.threadsPool);
+    out << buf;
+    if (!relatorio.hashes.empty()) {
+        out << "\"hashes\":[";
+        for (size_t i = 0; i < relatorio.hashes.size(); ++i) {
+            snprintf(buf, sizeof(buf), "%s\"%016llx\"", i ? "," : "",
+                     (unsigned long long)relatorio.hashes[i]);
+            out << buf;
+        }
+        out << "],";
+    }
+    out << "\"renderer\":\"";
+    for (const char* c = renderer ? renderer : ""; *c; ++c) {
+        if (*c == '"' || *c == '\\') out << '\\';
+        out << *c;
+    }
+    out << "\"}" << std::endl;
+}
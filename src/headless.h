@@ -0,0 +1,64 @@
+/*
+ * headless.h
+ *
+ * Contexto OpenGL fora da tela para rodar o programa sem janela (--headless),
+ * em servidores sem display nem GPU. Usa EGL: primeiro a plataforma
+ * surfaceless do Mesa com um pbuffer, e, se não houver pbuffer, um contexto
+ * sem superfície desenhando num framebuffer object do mesmo tamanho.
+ */
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * O que o modo headless mede: tempo de cada frame (ms), o relógio usado, o
+ * campo de estrelas e o pool de tarefas com que rodou (para comparar a
+ * escala entre execuções) e, se pedido, um hash FNV-1a dos pixels de cada
+ * frame para comparar execuções frame a frame.
+ */
+struct RelatorioHeadless {
+    int         largura;
+    int         altura;
+    std::string modoRelogio;
+    double      passoRelogio;
+    int         estrelas;
+    std::string motorEstrelas;
+    int         threadsPool;
+    std::vector<double>   temposMs;
+    std::vector<uint64_t> hashes;
+};
+
+/*
+ * Cria o contexto e o deixa atual nesta thread. Retorna false (com a causa
+ * no cerr) se o EGL não estiver disponível.
+ */
+bool criarContextoHeadless(int largura, int altura);
+
+/*
+ * Fim do frame fora da tela. Espera a GPU terminar (glFinish) para que o
+ * tempo medido do frame inclua o desenho, e não só o envio dos comandos.
+ */
+void trocarBuffersHeadless();
+
+void encerrarContextoHeadless();
+
+/*
+ * Hash FNV-1a de 64 bits do framebuffer atual (RGBA8), lido com
+ * glReadPixels. Força a sincronização com a GPU; fica fora do tempo medido.
+ */
+uint64_t hashFramebuffer(int largura, int altura, std::vector<unsigned char>& pixels);
+
+/*
+ * Escreve em 'out' um objeto JSON com a quantidade de frames, o tempo
+ * total, o FPS, média, p50, p95, p99 e máximo do tempo de frame (ms), o
+ * modo do relógio, as estrelas, as threads do pool e os hashes dos frames,
+ * se houver.
+ */
+void imprimirEstatisticasJson(std::ostream& out, const RelatorioHeadless& relatorio);
+
+#endif
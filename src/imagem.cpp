@@ -0,0 +1,267 @@
+/*
+ * imagem.cpp
+ *
+ * Decodificadores de imagem usados pelas faces do cubo. O único lugar do
+ * projeto que inclui a implementação do stb_image.
+ */
+
+#include "imagem.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#if __has_include("stb_image.h")
+    #define STB_IMAGE_IMPLEMENTATION
+    #include "stb_image.h"
+    #define HAS_STB_IMAGE 1
+#else
+    #define HAS_STB_IMAGE 0
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <wincodec.h>
+
+struct ComInit {
+    HRESULT hr;
+    ComInit() : hr(CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED)) {}
+    ~ComInit() {
+        if (SUCCEEDED(hr)) {
+            CoUninitialize();
+        }
+    }
+};
+
+bool loadImageWicRgb(const std::string& path, int& width, int& height, std::vector<unsigned char>& dataRgb) {
+    ComInit com;
+    if (FAILED(com.hr)) {
+        return false;
+    }
+
+    IWICImagingFactory* factory = nullptr;
+    HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+    if (FAILED(hr) || !factory) {
+        return false;
+    }
+
+    std::wstring wpath(path.begin(), path.end());
+    IWICBitmapDecoder* decoder = nullptr;
+    hr = factory->CreateDecoderFromFilename(wpath.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder);
+    if (FAILED(hr) || !decoder) {
+        factory->Release();
+        return false;
+    }
+
+    IWICBitmapFrameDecode* frame = nullptr;
+    hr = decoder->GetFrame(0, &frame);
+    if (FAILED(hr) || !frame) {
+        decoder->Release();
+        factory->Release();
+        return false;
+    }
+
+    UINT w = 0;
+    UINT h = 0;
+    hr = frame->GetSize(&w, &h);
+    if (FAILED(hr) || w == 0 || h == 0) {
+        frame->Release();
+        decoder->Release();
+        factory->Release();
+        return false;
+    }
+
+    IWICFormatConverter* converter = nullptr;
+    hr = factory->CreateFormatConverter(&converter);
+    if (FAILED(hr) || !converter) {
+        frame->Release();
+        decoder->Release();
+        factory->Release();
+        return false;
+    }
+
+    hr = converter->Initialize(frame, GUID_WICPixelFormat24bppRGB, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+    if (FAILED(hr)) {
+        converter->Release();
+        frame->Release();
+        decoder->Release();
+        factory->Release();
+        return false;
+    }
+
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    dataRgb.resize(static_cast<size_t>(width) * static_cast<size_t>(height) * 3u);
+    UINT stride = static_cast<UINT>(width * 3);
+    UINT bufferSize = static_cast<UINT>(dataRgb.size());
+    hr = converter->CopyPixels(nullptr, stride, bufferSize, dataRgb.data());
+
+    converter->Release();
+    frame->Release();
+    decoder->Release();
+    factory->Release();
+
+    return SUCCEEDED(hr);
+}
+#endif
+
+
+namespace {
+bool loadPpm(const std::string& path, int& width, int& height, std::vector<unsigned char>& data) {
+    std::ifstream file(path.c_str());
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string magic;
+    file >> magic;
+    if (magic != "P3") {
+        return false;
+    }
+    file >> width >> height;
+    int maxVal = 0;
+    file >> maxVal;
+    if (!file.good() || width <= 0 || height <= 0 || maxVal <= 0) {
+        return false;
+    }
+    data.resize(static_cast<size_t>(width) * static_cast<size_t>(height) * 3u);
+    for (int i = 0; i < width * height; ++i) {
+        int r = 0;
+        int g = 0;
+        int b = 0;
+        file >> r >> g >> b;
+        if (!file.good()) {
+            return false;
+        }
+        data[static_cast<size_t>(i) * 3u + 0u] = static_cast<unsigned char>(r * 255 / maxVal);
+        data[static_cast<size_t>(i) * 3u + 1u] = static_cast<unsigned char>(g * 255 / maxVal);
+        data[static_cast<size_t>(i) * 3u + 2u] = static_cast<unsigned char>(b * 255 / maxVal);
+    }
+    return true;
+}
+
+void cropCenterSquare(int& width, int& height, std::vector<unsigned char>& dataRgb) {
+    if (width <= 0 || height <= 0) return;
+    if (width == height) return;
+
+    int side = (width < height) ? width : height;
+    int x0 = (width - side) / 2;
+    int y0 = (height - side) / 2;
+
+    std::vector<unsigned char> cropped(static_cast<size_t>(side) * static_cast<size_t>(side) * 3u);
+    for (int y = 0; y < side; ++y) {
+        int srcY = y0 + y;
+        for (int x = 0; x < side; ++x) {
+            int srcX = x0 + x;
+            size_t src = (static_cast<size_t>(srcY) * static_cast<size_t>(width) + static_cast<size_t>(srcX)) * 3u;
+            size_t dst = (static_cast<size_t>(y) * static_cast<size_t>(side) + static_cast<size_t>(x)) * 3u;
+            cropped[dst + 0u] = dataRgb[src + 0u];
+            cropped[dst + 1u] = dataRgb[src + 1u];
+            cropped[dst + 2u] = dataRgb[src + 2u];
+        }
+    }
+
+    width = side;
+    height = side;
+    dataRgb.swap(cropped);
+}
+
+void cropCenterSquareRgba(int& width, int& height, std::vector<unsigned char>& data) {
+    if (width <= 0 || height <= 0) return;
+    if (width == height) return;
+
+    int side = (width < height) ? width : height;
+    int x0 = (width - side) / 2;
+    int y0 = (height - side) / 2;
+    std::vector<unsigned char> cropped(static_cast<size_t>(side) * static_cast<size_t>(side) * 4u);
+    for (int y = 0; y < side; ++y) {
+        for (int x = 0; x < side; ++x) {
+            size_t src = (static_cast<size_t>(y0 + y) * static_cast<size_t>(width) + static_cast<size_t>(x0 + x)) * 4u;
+            size_t dst = (static_cast<size_t>(y) * static_cast<size_t>(side) + static_cast<size_t>(x)) * 4u;
+            cropped[dst+0] = data[src+0];
+            cropped[dst+1] = data[src+1];
+            cropped[dst+2] = data[src+2];
+            cropped[dst+3] = data[src+3];
+        }
+    }
+    width = side; height = side;
+    data.swap(cropped);
+}
+}
+
+/*
+ * Detecta canal alpha em PNGs e mantém RGBA só quando algum pixel é de
+ * fato translúcido; uma imagem de 4 canais toda opaca é reduzida a RGB.
+ * Imagens não quadradas são recortadas ao centro.
+ */
+bool decodificarImagem(const std::string& path, ImagemDecodificada& out) {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> data;
+    bool hasAlpha = false;
+    bool loaded   = false;
+
+#if HAS_STB_IMAGE
+    {
+        int channels = 0;
+        unsigned char* raw = stbi_load(path.c_str(), &width, &height, &channels, 0);
+        if (raw) {
+            size_t pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+            if (channels == 4) {
+                hasAlpha = false;
+                for (size_t i = 0; i < pixels; ++i) {
+                    if (raw[i * 4 + 3] < 255) {
+                        hasAlpha = true;
+                        break;
+                    }
+                }
+                if (hasAlpha) {
+                    data.assign(raw, raw + pixels * 4);
+                } else {
+                    data.resize(pixels * 3);
+                    for (size_t i = 0; i < pixels; ++i) {
+                        data[i * 3 + 0] = raw[i * 4 + 0];
+                        data[i * 3 + 1] = raw[i * 4 + 1];
+                        data[i * 3 + 2] = raw[i * 4 + 2];
+                    }
+                }
+            } else if (channels == 3) {
+                data.assign(raw, raw + pixels * 3);
+                hasAlpha = false;
+            } else {
+                data.resize(pixels * 3);
+                for (size_t i = 0; i < pixels; ++i) {
+                    unsigned char v = raw[i * static_cast<size_t>(channels)];
+                    data[i * 3 + 0] = v;
+                    data[i * 3 + 1] = v;
+                    data[i * 3 + 2] = v;
+                }
+            }
+            stbi_image_free(raw);
+            loaded = true;
+        } else {
+            std::cerr << "stb_image falhou: " << stbi_failure_reason() << std::endl;
+        }
+    }
+#endif
+
+    if (!loaded) {
+        loaded   = loadPpm(path, width, height, data);
+        hasAlpha = false;
+    }
+
+    if (!loaded) {
+        return false;
+    }
+
+    if (hasAlpha) {
+        cropCenterSquareRgba(width, height, data);
+    } else {
+        cropCenterSquare(width, height, data);
+    }
+
+    out.largura = width;
+    out.altura  = height;
+    out.temAlfa = hasAlpha;
+    out.pixels.swap(data);
+    return true;
+}
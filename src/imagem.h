@@ -0,0 +1,30 @@
+/*
+ * imagem.h
+ *
+ * Decodificação das fotos das faces, sem nenhuma chamada OpenGL. Tenta
+ * stb_image primeiro (se disponível) e cai para o leitor PPM interno. A
+ * imagem sai recortada ao quadrado central, em RGB ou RGBA, pronta para
+ * glTexImage2D. Por não tocar no contexto GL pode rodar em qualquer thread.
+ */
+
+#ifndef IMAGEM_H
+#define IMAGEM_H
+
+#include <string>
+#include <vector>
+
+struct ImagemDecodificada {
+    int  largura = 0;
+    int  altura  = 0;
+    bool temAlfa = false;
+    std::vector<unsigned char> pixels;
+};
+
+/*
+ * Lê e decodifica 'path' em 'out'. PNGs com algum pixel translúcido ficam
+ * em RGBA; o resto vira RGB. Retorna false se nenhum decodificador aceitar
+ * o arquivo.
+ */
+bool decodificarImagem(const std::string& path, ImagemDecodificada& out);
+
+#endif
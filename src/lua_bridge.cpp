@@ -6,7 +6,7 @@
  * ou de Lua de volta para C++ passa por essa pilha. 
  * para chamar uma função Lua a partir daqui, o padrão é sempre o mesmo:
  *
- *   lua_getglobal(L, "nomeDaFuncao") → empilha a função
+ *   lua_rawgeti(L, LUA_REGISTRYINDEX, ref) → empilha a função
  *   lua_push*(L, valor) → empilha cada argumento
  *   lua_pcall(L, nArgs, nRets, 0) → chama, substitui args+fn pelos retornos
  *   lua_to*(L, -N) → lê os retornos pelo índice negativo
@@ -15,28 +15,350 @@
  * se lua_pcall retorna algo diferente de LUA_OK, o topo da pilha contém a
  * mensagem de erro como string precisando fazer lua_pop para não vazar a pilha.
  *
+ * as funções não são buscadas pelo nome a cada chamada: init() resolve cada
+ * ponto de entrada uma única vez com lua_getglobal e guarda a função no
+ * registry com luaL_ref. o caminho quente só faz lua_rawgeti com o inteiro
+ * guardado, sem hash de string. um contador de geração marca cada (re)carga
+ * dos scripts e as referências são resolvidas de novo quando ele muda.
+ *
  * Cada método desta classe implementa exatamente essa sequência para a função
  * Lua que corresponde e onde a função não existe ou falha, há um fallback
  * em C++ para não travar o programa
  */
 
 #include "lua_bridge.h"
+#include "alocador_lua.h"
+#include "observador_scripts.h"
+#include "scripts_embutidos.h"
+#include "bench_scope.h"
+#include "trace.h"
 #include "background.h"
 #include "cubo.h"
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
+#ifdef BENCH_MODE
+#include "bench.h"
+#endif
+
 extern "C" {
     #include <lua.h>
     #include <lualib.h>
     #include <lauxlib.h>
 }
 
+/*
+ * todo método público da ponte abre com MEDIR_PONTE: o tempo entra na
+ * categoria Lua do monitor e o escopo aparece no trace, sem nada nos
+ * chamadores. os pontos de entrada seguem com CONTAR_CHAMADA, que guarda
+ * as estatísticas de cada um (veja ContadorPonte). no build normal não
+ * sobra código.
+ */
+#define MEDIR_PONTE(nome) BENCH_SCOPE(bench::Lua); TRACE_SCOPE(nome)
+
+/*
+ * pontos de entrada chamados pelo C++. a ordem casa com a tabela
+ * entradasLua, que dá o nome global de cada um e um nome alternativo
+ * opcional usado quando o principal não existe.
+ */
+enum FuncaoLua {
+    FN_MISTURAR_COR = 0,
+    FN_LIDAR_ENTRADA,
+    FN_DEFINIR_FOTO_FACE,
+    FN_INICIALIZAR_ESTRELAS,
+    FN_OBTER_POSICOES_ESTRELAS,
+    FN_RESOLVER_FACE_PICKING,
+    FN_OBTER_LINHAS_CONTROLES,
+    FN_TOTAL
+};
+
+struct EntradaLua {
+    const char* nome;
+    const char* alternativo;
+    const char* metodo;
+};
+
+static const EntradaLua entradasLua[FN_TOTAL] = {
+    {"mixColorsCurrent",      "mixColors", "misturarCor"},
+    {"lidarComEntrada",       nullptr,     "lidarComEntrada"},
+    {"definirFotoFace",       nullptr,     "definirFotoFace"},
+    {"inicializarEstrelas",   nullptr,     "inicializarEstrelas"},
+    {"obterPosicoesEstrelas", nullptr,     "obterPosicoesEstrelas"},
+    {"resolverFacePicking",   nullptr,     "resolverFacePicking"},
+    {"obterLinhasControles",  nullptr,     "obterLinhasControles"},
+};
+
+/*
+ * buffer de floats que pertence ao C++ e é visto pelo Lua como userdata.
+ * o userdata só guarda o ponteiro e o tamanho; a memória é do vetor do
+ * chamador e fica apontada apenas durante a chamada que o recebe.
+ */
+struct BufferFloat {
+    float* dados;
+    int    tamanho;
+};
+
+static const char* META_BUFFER_FLOAT = "cubo.BufferFloat";
+
+#ifdef BENCH_MODE
+/*
+ * contadores de um ponto de entrada, acumulados desde o início. a pilha é
+ * amostrada do lado do C++: com os argumentos empilhados antes do
+ * lua_pcall e com os retornos depois dele.
+ */
+struct EstatisticaPonte {
+    long long chamadas   = 0;
+    long long erros      = 0;
+    long long fallbacks  = 0;
+    long long vazamentos = 0;
+    double    totalUs    = 0.0;
+    float     minUs      = 0.0f;
+    float     maxUs      = 0.0f;
+    int       pilhaMax   = 0;
+    LatencyHistogram hist;
+};
+#endif
+
 struct LuaBridgeImpl {
-    lua_State* L;
+    lua_State* L                  = nullptr;
+    int        refs[FN_TOTAL]     = {};      // LUA_NOREF no construtor da ponte
+    unsigned   geracao            = 0;
+    unsigned   geracaoRefs        = 0;
+    int        refBufferEstrelas  = LUA_NOREF;
+    int        quantidadeEstrelas = 0;
+    AlocadorLua alocador;
+    unsigned long long alocadosUltimoPasso = 0;
+    long long  dividaGc           = 0;
+    unsigned long long ciclosGc   = 0;
+    unsigned   versaoControles    = 0;
+    ObservadorScripts  observador;
+    std::vector<std::string> scriptsAlterados;
+#ifdef BENCH_MODE
+    EstatisticaPonte  estatisticas[FN_TOTAL];
+    EstatisticaPonte* atual = nullptr;
+    std::vector<InitPhaseInfo> fasesInit;
+#endif
 };
 
-LuaBridge::LuaBridge() : impl(new LuaBridgeImpl{nullptr}) {}
+#ifdef BENCH_MODE
+/*
+ * mede uma chamada de ponto de entrada do começo ao fim do método, inclusive
+ * os caminhos de fallback, e confere se a pilha voltou ao tamanho inicial.
+ */
+class ContadorPonte {
+    LuaBridgeImpl*    impl;
+    EstatisticaPonte* e;
+    EstatisticaPonte* anterior;
+    BenchTP           inicio;
+    int               topo;
+
+public:
+    ContadorPonte(LuaBridgeImpl* i, FuncaoLua fn)
+        : impl(i), e(i ? &i->estatisticas[fn] : nullptr), anterior(i ? i->atual : nullptr),
+          inicio(BenchClock::now()), topo(i && i->L ? lua_gettop(i->L) : 0) {
+        if (impl) impl->atual = e;
+    }
+    ~ContadorPonte() {
+        if (!e) return;
+        float us = std::chrono::duration<float, std::micro>(BenchClock::now() - inicio).count();
+        if (e->chamadas == 0 || us < e->minUs) e->minUs = us;
+        if (us > e->maxUs) e->maxUs = us;
+        e->totalUs += us;
+        e->hist.add(us);
+        ++e->chamadas;
+        if (impl->L && lua_gettop(impl->L) != topo) ++e->vazamentos;
+        impl->atual = anterior;
+    }
+};
+
+#define CONTAR_CHAMADA(fn) ContadorPonte contadorPonte(impl, fn)
+
+/*
+ * fases do init: cada MARCAR_FASE guarda o tempo desde a marca anterior
+ * (ou desde INICIAR_FASES) com o nome dado. RETOMAR_FASES volta a contar
+ * de agora, depois de um trecho que marcou as próprias fases.
+ */
+static void marcarFase(LuaBridgeImpl* impl, const char* nome, BenchTP& inicio) {
+    BenchTP agora = BenchClock::now();
+    impl->fasesInit.push_back({nome, std::chrono::duration<float, std::micro>(agora - inicio).count()});
+    inicio = agora;
+}
+
+#define INICIAR_FASES()   BenchTP inicioFase = BenchClock::now()
+#define MARCAR_FASE(nome) marcarFase(impl, nome, inicioFase)
+#define RETOMAR_FASES()   (inicioFase = BenchClock::now())
+#else
+#define CONTAR_CHAMADA(fn) ((void)0)
+#define INICIAR_FASES()    ((void)0)
+#define MARCAR_FASE(nome)  ((void)0)
+#define RETOMAR_FASES()    ((void)0)
+#endif
+
+/*
+ * marca que a chamada em andamento foi respondida pelo C++. fora do build
+ * de bench não faz nada.
+ */
+static inline void contarFallback(LuaBridgeImpl* impl) {
+#ifdef BENCH_MODE
+    if (impl && impl->atual) ++impl->atual->fallbacks;
+#else
+    (void)impl;
+#endif
+}
+
+/*
+ * lua_pcall dos pontos de entrada. no build de bench anota a altura da
+ * pilha antes e depois e conta o erro quando a chamada falha.
+ */
+static int chamarLua(LuaBridgeImpl* impl, int nArgs, int nRets) {
+#ifdef BENCH_MODE
+    EstatisticaPonte* e = impl->atual;
+    if (e) e->pilhaMax = std::max(e->pilhaMax, lua_gettop(impl->L));
+    int status = lua_pcall(impl->L, nArgs, nRets, 0);
+    if (e) {
+        e->pilhaMax = std::max(e->pilhaMax, lua_gettop(impl->L));
+        if (status != LUA_OK) ++e->erros;
+    }
+    return status;
+#else
+    return lua_pcall(impl->L, nArgs, nRets, 0);
+#endif
+}
+
+/*
+ * os métodos do buffer levam o ponteiro do userdata como upvalue e só
+ * aceitam esse mesmo userdata como primeiro argumento. o __metatable
+ * esconde a metatable do getmetatable, mas não do debug.getmetatable, então
+ * o script consegue chamá-los com qualquer valor. comparar com o upvalue
+ * sai mais barato que o luaL_checkudata, que buscaria a metatable no
+ * registry pelo nome a cada estrela.
+ */
+static BufferFloat* bufferDoArgumento(lua_State* L) {
+    BufferFloat* buf = (BufferFloat*)lua_touserdata(L, lua_upvalueindex(1));
+    luaL_argcheck(L, lua_touserdata(L, 1) == buf, 1, "esperado o buffer das estrelas");
+    return buf;
+}
+
+/*
+ * saida:estrela(i, x, y, r, g, b) escreve os cinco floats da estrela i
+ * direto na memória do C++: uma chamada por estrela em vez de cinco
+ * atribuições. O tamanho é fixo, então i fora de 1..#saida é erro.
+ */
+static int bufferFloatEstrela(lua_State* L) {
+    BufferFloat* buf = bufferDoArgumento(L);
+    lua_Integer i = luaL_checkinteger(L, 2);
+    if (i < 1 || i > buf->tamanho / 5)
+        return luaL_error(L, "estrela %d fora do buffer (%d estrelas)", (int)i, buf->tamanho / 5);
+    float* estrela = buf->dados + (i - 1) * 5;
+    for (int c = 0; c < 5; ++c)
+        estrela[c] = (float)luaL_checknumber(L, 3 + c);
+    return 0;
+}
+
+// #saida é o número de estrelas
+static int bufferFloatLen(lua_State* L) {
+    BufferFloat* buf = bufferDoArgumento(L);
+    lua_pushinteger(L, buf->tamanho / 5);
+    return 1;
+}
+
+/*
+ * cria o userdata usado pelas estrelas, guardado no registry para ser
+ * reaproveitado em todo frame, e a metatable dele, com o ponteiro como
+ * upvalue de cada método.
+ */
+static void criarBufferEstrelas(LuaBridgeImpl* impl) {
+    lua_State* L = impl->L;
+    BufferFloat* buf = (BufferFloat*)lua_newuserdata(L, sizeof(BufferFloat));
+    buf->dados   = nullptr;
+    buf->tamanho = 0;
+
+    lua_createtable(L, 0, 3);
+    lua_createtable(L, 0, 1);
+    lua_pushlightuserdata(L, buf);
+    lua_pushcclosure(L, bufferFloatEstrela, 1);
+    lua_setfield(L, -2, "estrela");
+    lua_setfield(L, -2, "__index");
+    lua_pushlightuserdata(L, buf);
+    lua_pushcclosure(L, bufferFloatLen, 1);
+    lua_setfield(L, -2, "__len");
+    lua_pushstring(L, META_BUFFER_FLOAT);
+    lua_setfield(L, -2, "__metatable");
+    lua_setmetatable(L, -2);
+
+    impl->refBufferEstrelas = luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+/*
+ * avisarControlesAlterados() do ui.lua: avança a versão das linhas do
+ * painel, para o C++ saber que a cópia que ele guarda ficou velha.
+ */
+static int avisarControlesAlterados(lua_State* L) {
+    LuaBridgeImpl* impl = (LuaBridgeImpl*)lua_touserdata(L, lua_upvalueindex(1));
+    ++impl->versaoControles;
+    return 0;
+}
+
+static void registrarFuncoesC(LuaBridgeImpl* impl) {
+    lua_pushlightuserdata(impl->L, impl);
+    lua_pushcclosure(impl->L, avisarControlesAlterados, 1);
+    lua_setglobal(impl->L, "avisarControlesAlterados");
+}
+
+/*
+ * solta as referências guardadas no registry. Depois disso empilharFuncao
+ * trata todos os pontos de entrada como ausentes até a próxima resolução.
+ */
+static void liberarReferencias(LuaBridgeImpl* impl) {
+    for (int i = 0; i < FN_TOTAL; ++i) {
+        if (impl->L && impl->refs[i] != LUA_NOREF)
+            luaL_unref(impl->L, LUA_REGISTRYINDEX, impl->refs[i]);
+        impl->refs[i] = LUA_NOREF;
+    }
+}
+
+/*
+ * resolve cada ponto de entrada pelo nome global uma única vez e guarda a
+ * função no registry. luaL_ref desempilha o valor e devolve o inteiro que
+ * depois é usado com lua_rawgeti. o que não for função fica como LUA_NOREF.
+ */
+static void resolverReferencias(LuaBridgeImpl* impl) {
+    liberarReferencias(impl);
+    lua_State* L = impl->L;
+    for (int i = 0; i < FN_TOTAL; ++i) {
+        lua_getglobal(L, entradasLua[i].nome);
+        if (!lua_isfunction(L, -1) && entradasLua[i].alternativo) {
+            lua_pop(L, 1);
+            lua_getglobal(L, entradasLua[i].alternativo);
+        }
+        if (lua_isfunction(L, -1)) {
+            impl->refs[i] = luaL_ref(L, LUA_REGISTRYINDEX);
+        } else {
+            lua_pop(L, 1);
+        }
+    }
+    impl->geracaoRefs = impl->geracao;
+}
+
+/*
+ * empilha a função do ponto de entrada direto do registry. se os scripts
+ * foram recarregados desde a última resolução, resolve tudo de novo antes.
+ * retorna false sem mexer na pilha quando a função não existe em Lua.
+ */
+static bool empilharFuncao(LuaBridgeImpl* impl, FuncaoLua fn) {
+    if (impl->geracaoRefs != impl->geracao)
+        resolverReferencias(impl);
+    if (impl->refs[fn] == LUA_NOREF) return false;
+    lua_rawgeti(impl->L, LUA_REGISTRYINDEX, impl->refs[fn]);
+    return true;
+}
+
+LuaBridge::LuaBridge() : impl(new LuaBridgeImpl()) {
+    for (int i = 0; i < FN_TOTAL; ++i) impl->refs[i] = LUA_NOREF;
+}
 
 LuaBridge::~LuaBridge() {
     if (impl) {
@@ -46,47 +368,302 @@ LuaBridge::~LuaBridge() {
     }
 }
 
+static const char* arquivosScripts[] = {"background.lua", "mixer.lua", "controle.lua", "faces.lua", "ui.lua"};
+
+/*
+ * diretório de CUBO_LUA_DIR, para desenvolver sem recompilar, ou nullptr
+ * para usar só os scripts embutidos.
+ */
+static const char* diretorioScripts() {
+    const char* dir = std::getenv("CUBO_LUA_DIR");
+    return (dir && *dir) ? dir : nullptr;
+}
+
+/*
+ * empilha o chunk de 'nome' já compilado. com diretório, o arquivo de lá
+ * tem preferência; se ele não existir vale o embutido. 'origem' diz de
+ * onde veio, para a mensagem de carga.
+ */
+static int compilarScript(lua_State* L, const char* nome, const char* dir, std::string& origem) {
+    if (dir) {
+        origem = std::string(dir) + "/" + nome;
+        int status = luaL_loadfile(L, origem.c_str());
+        if (status != LUA_ERRFILE) return status;
+        lua_pop(L, 1);
+    }
+    for (int i = 0; i < quantidadeScriptsEmbutidos; ++i) {
+        const ScriptEmbutido& e = scriptsEmbutidos[i];
+        if (std::strcmp(e.nome, nome) != 0) continue;
+        origem = std::string(nome) + (e.bytecode ? " (bytecode embutido)" : " (texto embutido)");
+        std::string chunk = std::string("@lua/") + nome;
+        return luaL_loadbuffer(L, (const char*)e.dados, e.tamanho, chunk.c_str());
+    }
+    origem = nome;
+    lua_pushfstring(L, "%s não está embutido no binário", nome);
+    return LUA_ERRFILE;
+}
+
+/*
+ * carrega cada script do projeto em ordem, do binário ou de CUBO_LUA_DIR,
+ * sem procurar arquivo nenhum no caminho normal. se algum script falhar,
+ * imprime a mensagem que Lua deixou no topo da pilha e retorna false.
+ */
+static bool carregarScripts(LuaBridgeImpl* impl) {
+    lua_State* L = impl->L;
+    const char* dir = diretorioScripts();
+    INICIAR_FASES();
+    for (const char* nome : arquivosScripts) {
+        std::string origem;
+        int status = compilarScript(L, nome, dir, origem);
+        if (status == LUA_OK) status = lua_pcall(L, 0, 0, 0);
+        MARCAR_FASE(nome);
+        if (status != LUA_OK) {
+            const char* msg = lua_tostring(L, -1);
+            std::cerr << "Erro ao carregar " << origem << ": " << (msg ? msg : "") << std::endl;
+            lua_pop(L, 1);
+            return false;
+        }
+        std::cout << "Carregado: " << origem << std::endl;
+    }
+    return true;
+}
+
+/*
+ * erro fora de qualquer pcall: o Lua vai abortar o processo logo depois,
+ * então só resta deixar a mensagem.
+ */
+static int panicoLua(lua_State* L) {
+    const char* msg = lua_tostring(L, -1);
+    std::cerr << "Erro fatal no Lua: " << (msg ? msg : "(sem mensagem)") << std::endl;
+    return 0;
+}
+
 /*
- * cria um novo lua_State com todas as bibliotecas padrão,
- * depois carrega cada script do projeto em ordem. Para cada arquivo, tenta
- * primeiro o prefixo "lua/" depois o diretório atual e o primeiro que
- * carregar sem erro vence e se algum script falhar, imprime a mensagem que
- * Lua deixou no topo da pilha e retorna false
+ * cria um novo lua_State sobre o alocador da ponte, com todas as
+ * bibliotecas padrão, carrega os scripts e resolve as referências de todos
+ * os pontos de entrada.
  */
 bool LuaBridge::init() {
+    MEDIR_PONTE("LuaBridge::init");
     if (!impl) return false;
-    impl->L = luaL_newstate();
+#ifdef BENCH_MODE
+    impl->fasesInit.clear();
+#endif
+    INICIAR_FASES();
+    impl->L = lua_newstate(AlocadorLua::funcao, &impl->alocador);
     if (!impl->L) {
         std::cerr << "Erro ao criar estado Lua!" << std::endl;
         return false;
     }
+    lua_atpanic(impl->L, panicoLua);
+
+    // coletor incremental e parado: quem decide quando coletar é o
+    // passoColetor, fora das chamadas do frame.
+#if LUA_VERSION_NUM >= 504
+    lua_gc(impl->L, LUA_GCINC, 0, 0, 0);
+#endif
+    lua_gc(impl->L, LUA_GCSTOP, 0);
+    MARCAR_FASE("estado");
 
     luaL_openlibs(impl->L);
+    MARCAR_FASE("bibliotecas");
+
+    criarBufferEstrelas(impl);
+    registrarFuncoesC(impl);
+
+    if (!carregarScripts(impl)) return false;
+
+    RETOMAR_FASES();
+    ++impl->geracao;
+    resolverReferencias(impl);
+    MARCAR_FASE("referencias");
 
-    const char* files[] = {"background.lua", "mixer.lua", "controle.lua", "faces.lua", "ui.lua"};
-    const char* prefixes[] = {"lua/", ""};
-
-    for (int i = 0; i < 5; i++) {
-        bool loaded = false;
-        for (int p = 0; p < 2; p++) {
-            std::string path = std::string(prefixes[p]) + files[i];
-            if (luaL_dofile(impl->L, path.c_str()) == LUA_OK) {
-                std::cout << "Carregado: " << path << std::endl;
-                loaded = true;
-                break;
-            }
+    if (const char* dir = diretorioScripts()) {
+        if (impl->observador.observar(dir))
+            std::cout << "Observando " << dir << ": scripts alterados são recarregados" << std::endl;
+    }
+    return true;
+}
+
+void LuaBridge::definirLimiteMemoria(size_t bytes) {
+    if (impl) impl->alocador.definirLimite(bytes);
+}
+
+EstatisticasMemoriaLua LuaBridge::obterMemoria() const {
+    if (!impl) return EstatisticasMemoriaLua{};
+    return impl->alocador.estatisticas();
+}
+
+/*
+ * a cada passo, quantos kB o coletor trata como alocados (lua_gc com
+ * LUA_GCSTEP) e o múltiplo da memória alocada que vira trabalho de coleta,
+ * como o stepmul do próprio Lua. acima de DIVIDA_MAXIMA_GC bytes
+ * pendentes o orçamento é ignorado para a memória não crescer sem fim.
+ */
+static const int       PASSO_GC_KB      = 16;
+static const long long MULTIPLO_GC      = 2;
+static const long long DIVIDA_MAXIMA_GC = 8ll * 1024 * 1024;
+
+void LuaBridge::passoColetor(double orcamentoUs) {
+    if (!impl || !impl->L) return;
+    unsigned long long alocados = impl->alocador.estatisticas().bytesAlocados;
+    impl->dividaGc += (long long)(alocados - impl->alocadosUltimoPasso) * MULTIPLO_GC;
+    impl->alocadosUltimoPasso = alocados;
+    if (impl->dividaGc <= 0) return;
+
+    BENCH_SCOPE(bench::GC);
+    TRACE_SCOPE("LuaBridge::passoColetor");
+    auto inicio = std::chrono::steady_clock::now();
+    while (impl->dividaGc > 0) {
+        bool fimCiclo = lua_gc(impl->L, LUA_GCSTEP, PASSO_GC_KB) != 0;
+        impl->dividaGc -= PASSO_GC_KB * 1024;
+        if (fimCiclo) {
+            ++impl->ciclosGc;
+            impl->dividaGc = 0;
+            break;
         }
-        if (!loaded) {
-            std::cerr << "Erro ao carregar " << files[i] << ": "
-                      << lua_tostring(impl->L, -1) << std::endl;
-            lua_pop(impl->L, 1);
-            return false;
+        double gastoUs = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - inicio).count();
+        if (gastoUs >= orcamentoUs && impl->dividaGc < DIVIDA_MAXIMA_GC) break;
+    }
+    // o que o próprio coletor alocou durante os passos não vira dívida nova
+    impl->alocadosUltimoPasso = impl->alocador.estatisticas().bytesAlocados;
+}
+
+unsigned long long LuaBridge::ciclosColetor() const {
+    return impl ? impl->ciclosGc : 0;
+}
+
+/*
+ * copia rasa das globais: chave e valor de _G numa table nova, deixada no
+ * topo da pilha.
+ */
+static void copiarGlobais(lua_State* L) {
+    lua_newtable(L);
+    lua_pushglobaltable(L);
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, -5);
+    }
+    lua_pop(L, 1);
+}
+
+/*
+ * volta _G ao que estava na cópia em 'indiceCopia': apaga as globais que
+ * o script criou e devolve o valor antigo das que ele trocou. tables que
+ * já existiam e foram alteradas por dentro não voltam.
+ */
+static void restaurarGlobais(lua_State* L, int indiceCopia) {
+    lua_pushglobaltable(L);
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {
+        lua_pop(L, 1);
+        lua_pushvalue(L, -1);
+        lua_rawget(L, indiceCopia);
+        bool existia = !lua_isnil(L, -1);
+        lua_pop(L, 1);
+        if (!existia) {
+            // apagar um campo já visitado durante o lua_next é permitido
+            lua_pushvalue(L, -1);
+            lua_pushnil(L);
+            lua_rawset(L, -4);
         }
     }
+    lua_pushnil(L);
+    while (lua_next(L, indiceCopia)) {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, -4);
+    }
+    lua_pop(L, 1);
+}
+
+/*
+ * executa 'nome' de novo no estado vivo. se o script não compilar nada
+ * muda; se der erro no meio da execução as globais voltam ao que eram
+ * antes dele, então o que estava rodando continua com a versão anterior.
+ * 'estrelasTrocadas' diz se inicializarEstrelas foi redefinida, caso em
+ * que a tabela de estrelas do script novo ainda está vazia.
+ */
+static bool recarregarScript(LuaBridgeImpl* impl, const char* nome, bool& estrelasTrocadas) {
+    lua_State* L = impl->L;
+    std::string origem;
+    if (compilarScript(L, nome, diretorioScripts(), origem) != LUA_OK) {
+        const char* msg = lua_tostring(L, -1);
+        std::cerr << "Recarga de " << origem << " falhou, versão anterior mantida: "
+                  << (msg ? msg : "") << std::endl;
+        lua_pop(L, 1);
+        return false;
+    }
 
+    copiarGlobais(L);
+    int indiceCopia = lua_gettop(L);
+    lua_pushvalue(L, -2);
+    if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
+        const char* msg = lua_tostring(L, -1);
+        std::cerr << "Recarga de " << origem << " falhou, versão anterior mantida: "
+                  << (msg ? msg : "") << std::endl;
+        lua_pop(L, 1);
+        restaurarGlobais(L, indiceCopia);
+        lua_pop(L, 2);
+        return false;
+    }
+
+    lua_getfield(L, indiceCopia, entradasLua[FN_INICIALIZAR_ESTRELAS].nome);
+    lua_getglobal(L, entradasLua[FN_INICIALIZAR_ESTRELAS].nome);
+    estrelasTrocadas = estrelasTrocadas || !lua_rawequal(L, -1, -2);
+    lua_pop(L, 4);
+
+    // qualquer script pode ter trocado obterLinhasControles
+    ++impl->geracao;
+    ++impl->versaoControles;
+    std::cout << "Recarregado: " << origem << std::endl;
     return true;
 }
 
+/*
+ * executa os scripts de novo no estado vivo, um a um e com a mesma volta
+ * atrás de recarregarScript. As funções globais são substituídas pelas
+ * novas, então a geração avança e as referências do registry são
+ * resolvidas outra vez na próxima chamada. Estrelas já geradas são geradas
+ * de novo, com a mesma quantidade, pelo inicializarEstrelas novo.
+ */
+bool LuaBridge::recarregarScripts() {
+    MEDIR_PONTE("LuaBridge::recarregarScripts");
+    if (!impl || !impl->L) return false;
+    bool ok = true, estrelasTrocadas = false;
+    for (const char* nome : arquivosScripts)
+        ok = recarregarScript(impl, nome, estrelasTrocadas) && ok;
+    if (estrelasTrocadas && impl->quantidadeEstrelas > 0)
+        inicializarEstrelas(impl->quantidadeEstrelas);
+    return ok;
+}
+
+/*
+ * chamado todo frame: sem nada novo no observador volta antes de medir,
+ * para o monitor e o trace não ganharem uma entrada vazia por frame.
+ */
+int LuaBridge::recarregarAlterados() {
+    if (!impl || !impl->L || !impl->observador.ativo()) return 0;
+    impl->observador.alterados(impl->scriptsAlterados);
+    if (impl->scriptsAlterados.empty()) return 0;
+
+    MEDIR_PONTE("LuaBridge::recarregarAlterados");
+    int recarregados = 0;
+    bool estrelasTrocadas = false;
+    // na ordem do init, que é a ordem em que um script pode depender do outro
+    for (const char* nome : arquivosScripts) {
+        const auto& alterados = impl->scriptsAlterados;
+        if (std::find(alterados.begin(), alterados.end(), nome) == alterados.end()) continue;
+        if (recarregarScript(impl, nome, estrelasTrocadas)) ++recarregados;
+    }
+    if (estrelasTrocadas && impl->quantidadeEstrelas > 0)
+        inicializarEstrelas(impl->quantidadeEstrelas);
+    return recarregados;
+}
+
 /*
  * Mistura a cor atual de uma face com um incremento de cor chamando
  * mixColorsCurrent em Lua ou mixcolors como fallback. Empilhamos os seis
@@ -97,19 +674,17 @@ bool LuaBridge::init() {
  */
 void LuaBridge::misturarCor(float r, float g, float b, float ar, float ag, float ab,
                          float& newR, float& newG, float& newB) {
+    MEDIR_PONTE("LuaBridge::misturarCor");
+    CONTAR_CHAMADA(FN_MISTURAR_COR);
     if (!impl || !impl->L) {
+        contarFallback(impl);
         newR = std::min(1.0f, r + ar);
         newG = std::min(1.0f, g + ag);
         newB = std::min(1.0f, b + ab);
         return;
     }
-    lua_getglobal(impl->L, "mixColorsCurrent");
-    if (!lua_isfunction(impl->L, -1)) {
-        lua_pop(impl->L, 1);
-        lua_getglobal(impl->L, "mixColors");
-    }
-    if (!lua_isfunction(impl->L, -1)) {
-        lua_pop(impl->L, 1);
+    if (!empilharFuncao(impl, FN_MISTURAR_COR)) {
+        contarFallback(impl);
         newR = std::min(1.0f, r + ar);
         newG = std::min(1.0f, g + ag);
         newB = std::min(1.0f, b + ab);
@@ -123,13 +698,14 @@ void LuaBridge::misturarCor(float r, float g, float b, float ar, float ag, float
     lua_pushnumber(impl->L, ag);
     lua_pushnumber(impl->L, ab);
 
-    if (lua_pcall(impl->L, 6, 3, 0) == LUA_OK) {
+    if (chamarLua(impl, 6, 3) == LUA_OK) {
         newB = (float)lua_tonumber(impl->L, -1);
         newG = (float)lua_tonumber(impl->L, -2);
         newR = (float)lua_tonumber(impl->L, -3);
         lua_pop(impl->L, 3);
     } else {
         lua_pop(impl->L, 1);
+        contarFallback(impl);
         newR = std::min(1.0f, r + ar);
         newG = std::min(1.0f, g + ag);
         newB = std::min(1.0f, b + ab);
@@ -142,16 +718,17 @@ void LuaBridge::misturarCor(float r, float g, float b, float ar, float ag, float
  * esses valores são aplicados diretamente na rotação do cubo.
  */
 void LuaBridge::lidarComEntrada(Cubo& cube, unsigned char key) {
-    if (!impl || !impl->L) return;
-    lua_getglobal(impl->L, "lidarComEntrada");
-    if (!lua_isfunction(impl->L, -1)) {
+    MEDIR_PONTE("LuaBridge::lidarComEntrada");
+    CONTAR_CHAMADA(FN_LIDAR_ENTRADA);
+    if (!impl || !impl->L) { contarFallback(impl); return; }
+    if (!empilharFuncao(impl, FN_LIDAR_ENTRADA)) {
+        contarFallback(impl);
         std::cerr << "Função lidarComEntrada não encontrada!" << std::endl;
-        lua_pop(impl->L, 1);
         return;
     }
 
     lua_pushinteger(impl->L, key);
-    if (lua_pcall(impl->L, 1, 3, 0) == LUA_OK) {
+    if (chamarLua(impl, 1, 3) == LUA_OK) {
         float dx = (float)lua_tonumber(impl->L, -3);
         float dy = (float)lua_tonumber(impl->L, -2);
         float dz = (float)lua_tonumber(impl->L, -1);
@@ -169,15 +746,13 @@ void LuaBridge::lidarComEntrada(Cubo& cube, unsigned char key) {
  * registrado no estado interno do script.
  */
 void LuaBridge::definirFotoFace(int faceIndex, const std::string& path) {
-    if (!impl || !impl->L) return;
-    lua_getglobal(impl->L, "definirFotoFace");
-    if (!lua_isfunction(impl->L, -1)) {
-        lua_pop(impl->L, 1);
-        return;
-    }
+    MEDIR_PONTE("LuaBridge::definirFotoFace");
+    CONTAR_CHAMADA(FN_DEFINIR_FOTO_FACE);
+    if (!impl || !impl->L) { contarFallback(impl); return; }
+    if (!empilharFuncao(impl, FN_DEFINIR_FOTO_FACE)) { contarFallback(impl); return; }
     lua_pushinteger(impl->L, faceIndex);
     lua_pushstring(impl->L, path.c_str());
-    if (lua_pcall(impl->L, 2, 0, 0) != LUA_OK) {
+    if (chamarLua(impl, 2, 0) != LUA_OK) {
         lua_pop(impl->L, 1);
     }
 }
@@ -188,73 +763,86 @@ void LuaBridge::definirFotoFace(int faceIndex, const std::string& path) {
  * é chamada uma única vez após init().
  */
 void LuaBridge::inicializarEstrelas(int count) {
-    if (!impl || !impl->L) return;
-    lua_getglobal(impl->L, "inicializarEstrelas");
-    if (!lua_isfunction(impl->L, -1)) {
-        lua_pop(impl->L, 1);
-        return;
-    }
+    MEDIR_PONTE("LuaBridge::inicializarEstrelas");
+    CONTAR_CHAMADA(FN_INICIALIZAR_ESTRELAS);
+    if (!impl || !impl->L) { contarFallback(impl); return; }
+    impl->quantidadeEstrelas = count;
+    if (!empilharFuncao(impl, FN_INICIALIZAR_ESTRELAS)) { contarFallback(impl); return; }
     lua_pushinteger(impl->L, count);
-    if (lua_pcall(impl->L, 1, 0, 0) != LUA_OK) {
+    if (chamarLua(impl, 1, 0) != LUA_OK) {
         lua_pop(impl->L, 1);
     }
 }
 
 /*
- * Chama obterPosicoesEstrelas em background.lua e lê a tabela flat
- * retornada. Lua retorna uma table indexada de 1 a N, onde cada grupo de
- * cinco valores consecutivos é x, y, r, g, b de uma estrela. Esses valores
- * são lidos com lua_rawgeti e empilhados no vetor de saída para serem usados
- * diretamente em glVertex2f e glColor3f. se a função falhar o vetor fica vazio.
+ * Chama obterPosicoesEstrelas em background.lua passando o buffer
+ * compartilhado. O vetor de saída é dimensionado para cinco floats por
+ * estrela (x, y, r, g, b) e o userdata passa a apontar para ele, então o
+ * script escreve com saida:estrela direto na memória que o renderizador
+ * lê, sem table nova nem cópia elemento a elemento. Como o tamanho não
+ * muda entre frames o resize não realoca. Depois da chamada o userdata é
+ * desligado do vetor.
+ *
+ * Se o script devolver uma table (versão antiga que ignora o buffer), ela
+ * é copiada como antes. se a função falhar o vetor fica vazio.
  */
 void LuaBridge::obterPosicoesEstrelas(float t, std::vector<float>& out) {
-    out.clear();
-    if (!impl || !impl->L) return;
+    MEDIR_PONTE("LuaBridge::obterPosicoesEstrelas");
+    CONTAR_CHAMADA(FN_OBTER_POSICOES_ESTRELAS);
+    if (!impl || !impl->L) { contarFallback(impl); out.clear(); return; }
 
-    lua_getglobal(impl->L, "obterPosicoesEstrelas");
-    if (!lua_isfunction(impl->L, -1)) {
-        lua_pop(impl->L, 1);
-        return;
-    }
-    lua_pushnumber(impl->L, t);
-    if (lua_pcall(impl->L, 1, 1, 0) != LUA_OK) {
-        lua_pop(impl->L, 1);
-        return;
-    }
+    out.resize(static_cast<size_t>(impl->quantidadeEstrelas) * 5u);
+    if (!empilharFuncao(impl, FN_OBTER_POSICOES_ESTRELAS)) { contarFallback(impl); out.clear(); return; }
 
-    if (!lua_istable(impl->L, -1)) {
-        lua_pop(impl->L, 1);
+    lua_State* L = impl->L;
+    lua_pushnumber(L, t);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, impl->refBufferEstrelas);
+    BufferFloat* buf = (BufferFloat*)lua_touserdata(L, -1);
+    buf->dados   = out.data();
+    buf->tamanho = (int)out.size();
+
+    int status = chamarLua(impl, 2, 1);
+    buf->dados   = nullptr;
+    buf->tamanho = 0;
+
+    if (status != LUA_OK) {
+        lua_pop(L, 1);
+        out.clear();
         return;
     }
 
-    int n = (int)lua_rawlen(impl->L, -1);
-    out.reserve(n);
-    for (int i = 1; i <= n; ++i) {
-        lua_rawgeti(impl->L, -1, i);
-        out.push_back((float)lua_tonumber(impl->L, -1));
-        lua_pop(impl->L, 1);
+    if (lua_istable(L, -1)) {
+        int n = (int)lua_rawlen(L, -1);
+        out.resize(n);
+        for (int i = 1; i <= n; ++i) {
+            lua_rawgeti(L, -1, i);
+            out[i - 1] = (float)lua_tonumber(L, -1);
+            lua_pop(L, 1);
+        }
     }
 
-    lua_pop(impl->L, 1);
+    lua_pop(L, 1);
 }
 
 /*
- * Converte o byte R lido por glReadPixels em índice de face chamando
- * resolverFacePicking em faces.lua. 
- * o cubo pinta cada face com glColor3ub durante o picking.
+ * Converte o identificador devolvido por Cubo::lancarRaioPicking em índice
+ * de face chamando resolverFacePicking em faces.lua.
+ * o picking numera as faces de 1 a 6 e usa 0 quando o raio não acerta.
  * se a chamada falhar faz a mesma conta em C++ como fallback.
  */
-int LuaBridge::resolverFacePicking(int pixelR) {
+int LuaBridge::resolverFacePicking(int idPicking) {
+    MEDIR_PONTE("LuaBridge::resolverFacePicking");
+    CONTAR_CHAMADA(FN_RESOLVER_FACE_PICKING);
     if (!impl || !impl->L) {
-        return (pixelR >= 1 && pixelR <= 6) ? pixelR - 1 : -1;
+        contarFallback(impl);
+        return (idPicking >= 1 && idPicking <= 6) ? idPicking - 1 : -1;
     }
-    lua_getglobal(impl->L, "resolverFacePicking");
-    if (!lua_isfunction(impl->L, -1)) {
-        lua_pop(impl->L, 1);
-        return (pixelR >= 1 && pixelR <= 6) ? pixelR - 1 : -1;
+    if (!empilharFuncao(impl, FN_RESOLVER_FACE_PICKING)) {
+        contarFallback(impl);
+        return (idPicking >= 1 && idPicking <= 6) ? idPicking - 1 : -1;
     }
-    lua_pushinteger(impl->L, pixelR);
-    if (lua_pcall(impl->L, 1, 1, 0) == LUA_OK) {
+    lua_pushinteger(impl->L, idPicking);
+    if (chamarLua(impl, 1, 1) == LUA_OK) {
         int face = (int)lua_tonumber(impl->L, -1);
         lua_pop(impl->L, 1);
         return face;
@@ -262,7 +850,8 @@ int LuaBridge::resolverFacePicking(int pixelR) {
     std::cerr << "Erro em resolverFacePicking: "
               << lua_tostring(impl->L, -1) << std::endl;
     lua_pop(impl->L, 1);
-    return (pixelR >= 1 && pixelR <= 6) ? pixelR - 1 : -1;
+    contarFallback(impl);
+    return (idPicking >= 1 && idPicking <= 6) ? idPicking - 1 : -1;
 }
 
 /*
@@ -304,14 +893,16 @@ static void lerTabelaLinhasUI(lua_State* L, std::vector<LinhaUI>& out) {
 
 /*
  * Chama obterLinhasControles em ui.lua e usa lerTabelaLinhasUI para
- * converter a tabela retornada em um vetor para o C++.
+ * converter a tabela retornada em um vetor para o C++. Quem desenha guarda
+ * o resultado e só chama de novo quando versaoControles() muda.
  */
 void LuaBridge::obterLinhasControles(std::vector<LinhaUI>& out) {
+    MEDIR_PONTE("LuaBridge::obterLinhasControles");
+    CONTAR_CHAMADA(FN_OBTER_LINHAS_CONTROLES);
     out.clear();
-    if (!impl || !impl->L) return;
-    lua_getglobal(impl->L, "obterLinhasControles");
-    if (!lua_isfunction(impl->L, -1)) { lua_pop(impl->L, 1); return; }
-    if (lua_pcall(impl->L, 0, 1, 0) != LUA_OK) {
+    if (!impl || !impl->L) { contarFallback(impl); return; }
+    if (!empilharFuncao(impl, FN_OBTER_LINHAS_CONTROLES)) { contarFallback(impl); return; }
+    if (chamarLua(impl, 0, 1) != LUA_OK) {
         std::cerr << "Erro em obterLinhasControles: "
                   << lua_tostring(impl->L, -1) << std::endl;
         lua_pop(impl->L, 1);
@@ -319,3 +910,40 @@ void LuaBridge::obterLinhasControles(std::vector<LinhaUI>& out) {
     }
     lerTabelaLinhasUI(impl->L, out);
 }
+
+unsigned LuaBridge::versaoControles() const {
+    return impl ? impl->versaoControles : 0;
+}
+
+#ifdef BENCH_MODE
+/*
+ * copia os contadores de cada ponto de entrada para o formato do monitor,
+ * com os percentis lidos do histograma acumulado.
+ */
+void LuaBridge::coletarEstatisticas(std::vector<BridgeCallInfo>& out) const {
+    out.clear();
+    if (!impl) return;
+    out.reserve(FN_TOTAL);
+    for (int i = 0; i < FN_TOTAL; ++i) {
+        const EstatisticaPonte& e = impl->estatisticas[i];
+        BridgeCallInfo b;
+        b.name       = entradasLua[i].metodo;
+        b.calls      = e.chamadas;
+        b.errors     = e.erros;
+        b.fallbacks  = e.fallbacks;
+        b.stackLeaks = e.vazamentos;
+        b.totalUs    = e.totalUs;
+        b.minUs      = e.minUs;
+        b.maxUs      = e.maxUs;
+        b.p50Us      = e.chamadas ? e.hist.percentile(50.0f) : 0.0f;
+        b.p99Us      = e.chamadas ? e.hist.percentile(99.0f) : 0.0f;
+        b.stackMax   = e.pilhaMax;
+        out.push_back(b);
+    }
+}
+
+void LuaBridge::coletarFasesInit(std::vector<InitPhaseInfo>& out) const {
+    out.clear();
+    if (impl) out = impl->fasesInit;
+}
+#endif
@@ -8,10 +8,16 @@
 #ifndef LUA_BRIDGE_H
 #define LUA_BRIDGE_H
 
+#include <cstddef>
 #include <string>
 #include <vector>
+#include "alocador_lua.h"
 
 struct LuaBridgeImpl;
+#ifdef BENCH_MODE
+struct BridgeCallInfo;
+struct InitPhaseInfo;
+#endif
 
 class Cubo;
 class Background;
@@ -36,10 +42,56 @@ public:
     ~LuaBridge();
 
     /*
-     * Cria o lua_State, carrega as bibliotecas padrão e executa os scripts do projeto. 
+     * Cria o lua_State, carrega as bibliotecas padrão e executa os scripts do projeto.
+     * Os scripts vêm compilados de dentro do binário (scripts_embutidos.h); com a
+     * variável de ambiente CUBO_LUA_DIR, os arquivos desse diretório têm preferência.
+     * Cada função chamada pelo C++ é resolvida aqui uma vez e guardada no registry.
      */
     bool init();
 
+    /*
+     * Teto, em bytes, para a memória viva do lua_State; 0 desliga. Passado
+     * dele, as alocações do Lua falham com erro de memória em vez de o
+     * processo crescer. Pode ser chamado antes ou depois do init().
+     */
+    void definirLimiteMemoria(size_t bytes);
+
+    /*
+     * Bytes vivos, pico, bytes reservados pelo pool e contadores do
+     * alocador do lua_State.
+     */
+    EstatisticasMemoriaLua obterMemoria() const;
+
+    /*
+     * O coletor automático fica parado desde o init(); a coleta acontece
+     * só aqui, em passos incrementais, no tempo que sobra depois da troca
+     * de buffers. Os passos pagam a memória alocada desde a última chamada
+     * e param ao gastar 'orcamentoUs' microssegundos, a não ser que a
+     * dívida acumulada já seja grande demais para esperar o próximo frame.
+     */
+    void passoColetor(double orcamentoUs);
+
+    /*
+     * Ciclos completos do coletor feitos por passoColetor.
+     */
+    unsigned long long ciclosColetor() const;
+
+    /*
+     * Executa os scripts de novo no estado vivo e avança a geração, o que
+     * faz as referências das funções serem resolvidas outra vez. Um script
+     * que falha não deixa nada pela metade: as globais voltam ao que eram
+     * antes dele. As estrelas são geradas de novo com a mesma quantidade.
+     */
+    bool recarregarScripts();
+
+    /*
+     * Com CUBO_LUA_DIR definido, o init() passa a observar esse diretório.
+     * Chamado entre frames, recarrega do mesmo jeito que recarregarScripts
+     * só os scripts que mudaram desde a última chamada e retorna quantos
+     * entraram. Sem mudança, custa uma leitura não bloqueante.
+     */
+    int recarregarAlterados();
+
     /*
      * Chama mixColorsCurrent em Lua para misturar a cor atual de uma face
      * com um incremento de cor. Escreve o resultado nos três floats de saída.
@@ -66,22 +118,45 @@ public:
     void inicializarEstrelas(int count);
 
     /*
-     * Chama obterPosicoesEstrelas(t) em Lua e preenche 'out' com pacotes
-     * de 5 floats por estrela: x, y, r, g, b.
+     * Chama obterPosicoesEstrelas(t, buf) em Lua e preenche 'out' com pacotes
+     * de 5 floats por estrela: x, y, r, g, b. 'buf' é um userdata que aponta
+     * para a memória de 'out', então o script escreve direto no vetor.
      */
     void obterPosicoesEstrelas(float t, std::vector<float>& out);
 
     /*
-     * Passa o valor do canal R lido por glReadPixels para resolverFacePicking
-     * em Lua, que converte R=1..6 no índice de face 0..5.
+     * Passa o identificador de face do picking por raio para resolverFacePicking
+     * em Lua, que converte 1..6 no índice de face 0..5.
      */
-    int resolverFacePicking(int pixelR);
+    int resolverFacePicking(int idPicking);
 
     /*
      * Chama obterLinhasControles em Lua e popula 'out' com as LinhaUI para
      * o painel de controles flutuante.
      */
     void obterLinhasControles(std::vector<LinhaUI>& out);
+
+    /*
+     * Versão das linhas do painel. Muda quando o ui.lua chama
+     * avisarControlesAlterados() (ele chama ao ser carregado) e a cada
+     * script recarregado; enquanto não mudar, as linhas da última chamada a
+     * obterLinhasControles continuam valendo. Não toca no Lua.
+     */
+    unsigned versaoControles() const;
+
+#ifdef BENCH_MODE
+    /*
+     * Preenche 'out' com chamadas, erros, fallbacks, tempos e pilha máxima
+     * de cada ponto de entrada acima, acumulados desde a criação da ponte.
+     */
+    void coletarEstatisticas(std::vector<BridgeCallInfo>& out) const;
+
+    /*
+     * Tempo de cada fase do último init(): criação do estado, bibliotecas
+     * padrão, cada script e a resolução das referências.
+     */
+    void coletarFasesInit(std::vector<InitPhaseInfo>& out) const;
+#endif
 };
 
 #endif
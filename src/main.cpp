@@ -5,14 +5,26 @@
  */
 
 #include <GL/glut.h>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <cstdio>
 #include <iostream>
 #include <string>
+#include <vector>
 #include "cubo.h"
 #include "background.h"
 #include "lua_bridge.h"
+#include "headless.h"
+#include "relogio.h"
+#include "entrada_gravada.h"
+#include "simulacao_estrelas.h"
+#include "pool_tarefas.h"
+#include "bench_scope.h"
+#include "trace.h"
 
 #ifdef BENCH_MODE
 #include "bench.h"
@@ -21,27 +33,61 @@
 Cubo cube;
 Background background;
 LuaBridge bridge;
+Relogio relogio;
+GravadorEntrada   gravadorEntrada;
+ReprodutorEntrada reprodutorEntrada;
+SimulacaoEstrelas simulacaoEstrelas;
 
 int  larguraJanela  = 800;
 int  alturaJanela = 600;
 bool mostrarControles = false;
 
 static int janelaPrincipal  = 0;
+static bool modoHeadless    = false;
+static bool estrelasAsync   = false;
+static int  quantidadeEstrelas = 420;
+static MotorEstrelas motorInicial = MotorEstrelas::Lua;
 #ifdef BENCH_MODE
 static int janelaBenchmark = 0;
 
-static long estimateTexKb(const Cubo& c) {
-    long kb = 0;
-    for (int i = 0; i < 6; ++i)
-        if (c.faceTemTextura(i))
-            kb += (512 * 512 * 4) / 1024;
-    return kb;
+// Lê do cubo a memória real das texturas de cada face e dos buffers de upload.
+static TexMemInfo collectTexInfo(const Cubo& c) {
+    TexMemInfo info = {};
+    for (int i = 0; i < 6; ++i) {
+        InfoTextura t;
+        if (c.obterInfoTexturaFace(i, t))
+            info.faces[i] = {t.largura, t.altura, (unsigned)t.formatoInterno, t.niveis, (long long)t.bytes};
+    }
+    info.uniqueTextures = c.obterTexturas().quantidade();
+    info.gpuBytes       = (long long)c.obterTexturas().bytesResidentes();
+    info.stagingBytes   = (long long)c.bytesStagingTexturas();
+    return info;
 }
-static int countTex(const Cubo& c) {
-    int n = 0;
-    for (int i = 0; i < 6; ++i)
-        if (c.faceTemTextura(i)) ++n;
-    return n;
+
+// Copia as estatísticas do alocador do lua_State para o monitor.
+static LuaMemInfo collectLuaMemInfo(const LuaBridge& b) {
+    EstatisticasMemoriaLua m = b.obterMemoria();
+    LuaMemInfo info = {};
+    info.liveBytes = (long long)m.bytesVivos;
+    info.peakBytes = (long long)m.picoBytes;
+    info.poolBytes = (long long)m.bytesReservados;
+    info.capBytes  = (long long)m.limite;
+    info.allocs    = m.alocacoes;
+    info.frees     = m.liberacoes;
+    info.reallocs  = m.realocacoes;
+    info.pooled    = m.doPool;
+    info.failures  = m.falhas;
+    info.gcCycles  = b.ciclosColetor();
+    return info;
+}
+
+static PoolInfo collectPoolInfo() {
+    const PoolTarefas& pool = PoolTarefas::compartilhado();
+    PoolInfo info;
+    info.threads = pool.numeroThreads();
+    info.tasks   = pool.tarefasExecutadas();
+    info.steals  = pool.tarefasRoubadas();
+    return info;
 }
 #endif
 
@@ -92,7 +138,9 @@ static std::string openImageFileDialog() {
 #endif
 
 // Renderiza texto 2D na tela usando bitmap do GLUT.
+// Sem janela não há GLUT inicializado, então o texto é omitido.
 void drawText(float x, float y, const std::string& text) {
+    if (modoHeadless) return;
     glRasterPos2f(x, y);
     for (char ch : text) glutBitmapCharacter(GLUT_BITMAP_8_BY_13, ch);
 }
@@ -106,81 +154,225 @@ void displayBench() {
     glClearColor(0.04f, 0.04f, 0.08f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
+    std::vector<BridgeCallInfo> ponte;
+    bridge.coletarEstatisticas(ponte);
+    gBench.setBridgeInfo(ponte);
+    gBench.setLuaMemInfo(collectLuaMemInfo(bridge));
+    gBench.setPoolInfo(collectPoolInfo());
     gBench.draw(bw, bh);
 
     glutSwapBuffers();
 }
+
+// Grava as estatísticas atuais da ponte Lua em cubo_ponte.json.
+static void gravarEstatisticasPonte() {
+    std::vector<BridgeCallInfo> ponte;
+    bridge.coletarEstatisticas(ponte);
+    gBench.setBridgeInfo(ponte);
+    gBench.setLuaMemInfo(collectLuaMemInfo(bridge));
+    gBench.setPoolInfo(collectPoolInfo());
+    if (gBench.dumpBridgeJson("cubo_ponte.json"))
+        std::cout << "Estatísticas da ponte gravadas em cubo_ponte.json" << std::endl;
+}
+
+// Teclas da janela de benchmark: [ e ] dividem e dobram a janela de frames,
+// T grava o trace dos últimos frames e J as estatísticas da ponte Lua.
+void keyboardBench(unsigned char key, int, int) {
+    switch (key) {
+        case '[': gBench.setWindow(gBench.getWindow() / 2); break;
+        case ']': gBench.setWindow(gBench.getWindow() * 2); break;
+        case 't': case 'T':
+            if (trace::dump("cubo_trace.json"))
+                std::cout << "Trace gravado em cubo_trace.json" << std::endl;
+            break;
+        case 'j': case 'J':
+            gravarEstatisticasPonte();
+            break;
+        case 27:  exit(0);
+    }
+    glutPostRedisplay();
+}
 #endif
 
+// Apresenta o frame: troca de buffers da janela GLUT ou fim do frame
+// fora da tela no modo headless.
+static void trocarBuffers() {
+    if (modoHeadless) trocarBuffersHeadless();
+    else              glutSwapBuffers();
+}
+
+// Pede um novo frame à janela. No headless o laço de frames já desenha
+// todos, e o GLUT nem foi inicializado.
+static void pedirRedesenho() {
+    if (!modoHeadless) glutPostRedisplay();
+}
+
+// Frame em que um evento chegando agora será aplicado: o próximo a ser
+// desenhado.
+static uint32_t frameDoEvento() {
+    return (uint32_t)(relogio.numeroFrame() + 1);
+}
+
+// Aplica a foto a uma face como se tivesse vindo do seletor de arquivos.
+static void aplicarFoto(int face, const std::string& caminho) {
+    if (gravadorEntrada.gravando()) gravadorEntrada.foto(frameDoEvento(), face, caminho);
+    cube.definirFotoFaceDeArquivo(face, caminho);
+}
+
+// Tamanho gravado na reprodução: a janela é redimensionada e o GLUT chama
+// reshape. O contexto do headless tem tamanho fixo, então lá é ignorado.
+static void reproduzirTamanho(int w, int h) {
+    if (!modoHeadless) glutReshapeWindow(w, h);
+}
+
+void keyboard(unsigned char key, int x, int y);
+void specialKeys(int key, int x, int y);
+void mouse(int button, int state, int x, int y);
+void passiveMotion(int x, int y);
+
+// Duração alvo de um frame, a mesma do timer do GLUT, e os limites do tempo
+// dado à coleta do Lua depois da troca de buffers: metade da folga que
+// sobrou, nunca menos que o mínimo (para a coleta andar mesmo com frames
+// atrasados) nem mais que o máximo.
+static const double ALVO_FRAME_US       = 16000.0;
+static const double ORCAMENTO_GC_MIN_US = 100.0;
+static const double ORCAMENTO_GC_MAX_US = 4000.0;
+
+/*
+ * O painel (botão, fundo e linhas do ui.lua) fica gravado numa display
+ * list, refeita só quando muda o tamanho da janela, o painel abre ou
+ * fecha ou a versão das linhas no Lua avança. Nos outros frames é um
+ * glCallList: nenhuma chamada ao Lua, nenhum texto montado glifo a glifo
+ * e nenhuma alocação.
+ */
+static void desenharPainelControles() {
+    static GLuint   lista = 0;
+    static int      largura = -1, altura = -1;
+    static bool     aberto  = false;
+    static unsigned versao  = ~0u;   // nenhuma linha lida ainda
+    static std::vector<LinhaUI> linhas;
+
+    unsigned versaoAtual = bridge.versaoControles();
+    if (lista && largura == larguraJanela && altura == alturaJanela &&
+        aberto == mostrarControles && (!aberto || versao == versaoAtual)) {
+        glCallList(lista);
+        return;
+    }
+
+    TRACE_SCOPE("gravar painel UI");
+    if (!lista) lista = glGenLists(1);
+    if (mostrarControles && versao != versaoAtual) {
+        bridge.obterLinhasControles(linhas);
+        versao = versaoAtual;
+    }
+    largura = larguraJanela;
+    altura  = alturaJanela;
+    aberto  = mostrarControles;
+
+    glNewList(lista, GL_COMPILE_AND_EXECUTE);
+
+    float margin = 12.0f, btnW = 150.0f, btnH = 26.0f;
+    float x1 = larguraJanela  - margin - btnW;
+    float y1 = alturaJanela - margin - btnH;
+    float x2 = larguraJanela  - margin;
+    float y2 = alturaJanela - margin;
+
+    glColor4f(0.10f, 0.10f, 0.12f, 0.65f);
+    glBegin(GL_QUADS);
+    glVertex2f(x1,y1); glVertex2f(x2,y1);
+    glVertex2f(x2,y2); glVertex2f(x1,y2);
+    glEnd();
+
+    glColor4f(0.85f, 0.85f, 0.88f, 0.9f);
+    drawText(x1 + 10.0f, y1 + 9.0f, "Controles");
+
+    if (mostrarControles) {
+        float panelW = 300.0f, panelH = 200.0f;
+        float px2 = x2, py2 = y1 - 8.0f;
+        float px1 = px2 - panelW, py1 = py2 - panelH;
+
+        glColor4f(0.08f, 0.08f, 0.10f, 0.78f);
+        glBegin(GL_QUADS);
+        glVertex2f(px1,py1); glVertex2f(px2,py1);
+        glVertex2f(px2,py2); glVertex2f(px1,py2);
+        glEnd();
+
+        float tx = px1 + 10.0f, ty = py2 - 18.0f;
+        for (const auto& linha : linhas) {
+            glColor4f(linha.r, linha.g, linha.b, 0.92f);
+            drawText(tx, ty, linha.texto);
+            ty -= linha.passo;
+        }
+    }
+
+    glEndList();
+}
+
 // Renderiza a cena principal: background, cubo, botão de controles e painel.
 void display() {
+    TRACE_SCOPE("frame");
+    auto inicioFrame = std::chrono::steady_clock::now();
+    // scripts salvos desde o último frame entram antes de qualquer chamada
+    bridge.recarregarAlterados();
+    if (reprodutorEntrada.reproduzindo()) {
+        static const AlvosEntrada alvos = {
+            keyboard, specialKeys, mouse, passiveMotion, reproduzirTamanho, aplicarFoto
+        };
+        reprodutorEntrada.despachar(frameDoEvento(), alvos);
+    }
+    relogio.iniciarFrame();
 #ifdef BENCH_MODE
     gBench.frameBegin();
+    gBench.setClockInfo(relogio.nomeModo(), relogio.agora(), relogio.delta());
 #endif
 
+    // fotos decodificadas em segundo plano viram textura aqui, com o
+    // contexto atual; o Lua só fica sabendo do caminho depois do upload.
+    static std::vector<FotoCarregada> fotosProntas;
+    cube.processarCarregamentos(fotosProntas);
+    for (const auto& foto : fotosProntas)
+        bridge.definirFotoFace(foto.face, foto.caminho);
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    {
+        BENCH_SCOPE(bench::Render);
 #ifdef BENCH_MODE
-    gBench.cppRenderBegin();
+        gBench.gpuBegin(GPU_BACKGROUND);
+#endif
+        background.renderizar();
+#ifdef BENCH_MODE
+        gBench.gpuEnd();
 #endif
 
-    background.renderizar();
-
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    glTranslatef(0.0f, 0.0f, -5.0f);
-    cube.renderizar();
-
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        glTranslatef(0.0f, 0.0f, -5.0f);
+#ifdef BENCH_MODE
+        gBench.gpuBegin(GPU_CUBE);
+#endif
+        cube.renderizar();
 #ifdef BENCH_MODE
-    gBench.cppRenderEnd();
+        gBench.gpuEnd();
 #endif
+    }
 
+#ifdef BENCH_MODE
+    gBench.gpuBegin(GPU_UI);
+#endif
     {
+        TRACE_SCOPE("painel UI");
         glMatrixMode(GL_PROJECTION);
         glPushMatrix(); glLoadIdentity();
         glOrtho(0, larguraJanela, 0, alturaJanela, -1, 1);
         glMatrixMode(GL_MODELVIEW);
         glPushMatrix(); glLoadIdentity();
 
-        float margin = 12.0f, btnW = 150.0f, btnH = 26.0f;
-        float x1 = larguraJanela  - margin - btnW;
-        float y1 = alturaJanela - margin - btnH;
-        float x2 = larguraJanela  - margin;
-        float y2 = alturaJanela - margin;
-
         glDisable(GL_DEPTH_TEST);
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        glColor4f(0.10f, 0.10f, 0.12f, 0.65f);
-        glBegin(GL_QUADS);
-        glVertex2f(x1,y1); glVertex2f(x2,y1);
-        glVertex2f(x2,y2); glVertex2f(x1,y2);
-        glEnd();
-
-        glColor4f(0.85f, 0.85f, 0.88f, 0.9f);
-        drawText(x1 + 10.0f, y1 + 9.0f, "Controles");
-
-        if (mostrarControles) {
-            float panelW = 300.0f, panelH = 200.0f;
-            float px2 = x2, py2 = y1 - 8.0f;
-            float px1 = px2 - panelW, py1 = py2 - panelH;
-
-            glColor4f(0.08f, 0.08f, 0.10f, 0.78f);
-            glBegin(GL_QUADS);
-            glVertex2f(px1,py1); glVertex2f(px2,py1);
-            glVertex2f(px2,py2); glVertex2f(px1,py2);
-            glEnd();
-
-            std::vector<LinhaUI> linhas;
-            bridge.obterLinhasControles(linhas);
-            float tx = px1 + 10.0f, ty = py2 - 18.0f;
-            for (const auto& linha : linhas) {
-                glColor4f(linha.r, linha.g, linha.b, 0.92f);
-                drawText(tx, ty, linha.texto);
-                ty -= linha.passo;
-            }
-        }
+        desenharPainelControles();
 
         glDisable(GL_BLEND);
         glEnable(GL_DEPTH_TEST);
@@ -189,11 +381,19 @@ void display() {
         glPopMatrix();
         glMatrixMode(GL_MODELVIEW);
     }
+#ifdef BENCH_MODE
+    gBench.gpuEnd();
+#endif
 
-    glutSwapBuffers();
+    trocarBuffers();
+
+    double gastoUs = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - inicioFrame).count();
+    double folgaUs = ALVO_FRAME_US - gastoUs;
+    bridge.passoColetor(std::min(ORCAMENTO_GC_MAX_US, std::max(ORCAMENTO_GC_MIN_US, folgaUs * 0.5)));
 
 #ifdef BENCH_MODE
-    gBench.setTexInfo(countTex(cube), estimateTexKb(cube));
+    gBench.setTexInfo(collectTexInfo(cube));
     gBench.frameEnd();
     if (janelaBenchmark) glutPostWindowRedisplay(janelaBenchmark);
 #endif
@@ -201,62 +401,43 @@ void display() {
 
 // Controla o loop de renderização com intervalo de 16ms (60 FPS).
 void timer(int) {
-    glutPostRedisplay();
+    pedirRedesenho();
     glutTimerFunc(16, timer, 0);
 }
 
 // Processa entrada de teclado: rotação, cores, reset, imagem e painel.
 void keyboard(unsigned char key, int x, int y) {
+    // a foto é gravada com o caminho escolhido e o ESC não entra no log,
+    // senão a reprodução pararia ali.
+    if (gravadorEntrada.gravando() && key != 8 && key != 127 && key != 27)
+        gravadorEntrada.tecla(frameDoEvento(), key, x, y);
+
     switch(key) {
         case 'w': case 'W':
         case 's': case 'S':
         case 'a': case 'A':
         case 'd': case 'D':
-#ifdef BENCH_MODE
-            gBench.luaBegin();
-#endif
             bridge.lidarComEntrada(cube, key);
-#ifdef BENCH_MODE
-            gBench.luaEnd();
-#endif
             break;
 
         case '1': {
             Cor c = cube.obterCorFace(cube.obterFaceSelecionada());
             float nr, ng, nb;
-#ifdef BENCH_MODE
-            gBench.luaBegin();
-#endif
             bridge.misturarCor(c.vermelho, c.verde, c.azul, 1.0f, 0.0f, 0.0f, nr, ng, nb);
-#ifdef BENCH_MODE
-            gBench.luaEnd();
-#endif
             cube.definirCorFace(cube.obterFaceSelecionada(), nr, ng, nb);
             break;
         }
         case '2': {
             Cor c = cube.obterCorFace(cube.obterFaceSelecionada());
             float nr, ng, nb;
-#ifdef BENCH_MODE
-            gBench.luaBegin();
-#endif
             bridge.misturarCor(c.vermelho, c.verde, c.azul, 0.0f, 0.0f, 1.0f, nr, ng, nb);
-#ifdef BENCH_MODE
-            gBench.luaEnd();
-#endif
             cube.definirCorFace(cube.obterFaceSelecionada(), nr, ng, nb);
             break;
         }
         case '3': {
             Cor c = cube.obterCorFace(cube.obterFaceSelecionada());
             float nr, ng, nb;
-#ifdef BENCH_MODE
-            gBench.luaBegin();
-#endif
             bridge.misturarCor(c.vermelho, c.verde, c.azul, 0.0f, 1.0f, 0.0f, nr, ng, nb);
-#ifdef BENCH_MODE
-            gBench.luaEnd();
-#endif
             cube.definirCorFace(cube.obterFaceSelecionada(), nr, ng, nb);
             break;
         }
@@ -268,9 +449,7 @@ void keyboard(unsigned char key, int x, int y) {
             int face = cube.obterFaceSelecionada();
             std::string path = openImageFileDialog();
             if (path.empty()) break;
-            if (cube.definirFotoFaceDeArquivo(face, path)) {
-                bridge.definirFotoFace(face, path);
-            }
+            aplicarFoto(face, path);
             break;
         }
 
@@ -282,14 +461,19 @@ void keyboard(unsigned char key, int x, int y) {
             mostrarControles = !mostrarControles;
             break;
 
+        case 'e': case 'E':
+            background.alternarMotor();
+            break;
+
         case 27:
             exit(0);
     }
-    glutPostRedisplay();
+    pedirRedesenho();
 }
 
 // Processa teclas especiais para controle de escala e rotação da textura.
 void specialKeys(int key, int x, int y) {
+    if (gravadorEntrada.gravando()) gravadorEntrada.especial(frameDoEvento(), key, x, y);
     int face = cube.obterFaceSelecionada();
 
     switch (key) {
@@ -310,11 +494,12 @@ void specialKeys(int key, int x, int y) {
             cube.rotacionarTexturaFace(face, +1);
             break;
     }
-    glutPostRedisplay();
+    pedirRedesenho();
 }
 
 // Processa cliques do mouse para seleção de face, limpeza de cor e alternância do painel de controles.
 void mouse(int button, int state, int x, int y) {
+    if (gravadorEntrada.gravando()) gravadorEntrada.mouse(frameDoEvento(), button, state, x, y);
     if (state != GLUT_DOWN) return;
 
     if (button == GLUT_LEFT_BUTTON) {
@@ -326,17 +511,26 @@ void mouse(int button, int state, int x, int y) {
         float mx = (float)x, my = (float)(alturaJanela - y);
         if (mx >= x1 && mx <= x2 && my >= y1 && my <= y2) {
             mostrarControles = !mostrarControles;
-            glutPostRedisplay();
+            pedirRedesenho();
             return;
         }
-        int pixelR = cube.lerPixelPicking(x, y);
-        int face   = bridge.resolverFacePicking(pixelR);
+        ResultadoPicking r = cube.lancarRaioPicking(x, y);
+        int face = bridge.resolverFacePicking(r.id);
         cube.definirFaceSelecionada(face);
     }
     if (button == GLUT_RIGHT_BUTTON) {
         cube.limparCorFaceSelecionada();
     }
-    glutPostRedisplay();
+    pedirRedesenho();
+}
+
+// Destaca a face sob o mouse. O picking por raio é barato o bastante para
+// rodar a cada movimento; só redesenha quando a face destacada muda.
+void passiveMotion(int x, int y) {
+    if (gravadorEntrada.gravando()) gravadorEntrada.movimento(frameDoEvento(), x, y);
+    ResultadoPicking r = cube.lancarRaioPicking(x, y);
+    if (cube.definirFaceDestacada(bridge.resolverFacePicking(r.id)))
+        pedirRedesenho();
 }
 
 // Inicializa o estado do programa: OpenGL, Lua, background e cubo.
@@ -347,16 +541,21 @@ void init() {
     if (!bridge.init()) {
         exit(1);
     }
+#ifdef BENCH_MODE
+    std::vector<InitPhaseInfo> fases;
+    bridge.coletarFasesInit(fases);
+    gBench.setInitPhases(fases);
+#endif
 
     background.definirBridge(&bridge);
+    background.definirRelogio(&relogio);
+    if (estrelasAsync) {
+        simulacaoEstrelas.iniciar();
+        background.definirSimulacao(&simulacaoEstrelas);
+    }
 
-#ifdef BENCH_MODE
-    gBench.luaBegin();
-#endif
-    bridge.inicializarEstrelas(420);
-#ifdef BENCH_MODE
-    gBench.luaEnd();
-#endif
+    background.definirMotor(motorInicial);
+    background.inicializarEstrelas(quantidadeEstrelas);
 
     cube.definirRotacao(15.0f, 25.0f, 0.0f);
     background.definirPadrao();
@@ -365,6 +564,7 @@ void init() {
 
 // Ajusta a projeção e viewport quando a janela é redimensionada.
 void reshape(int w, int h) {
+    if (gravadorEntrada.gravando()) gravadorEntrada.tamanho(frameDoEvento(), w, h);
     if (h == 0) h = 1;
     larguraJanela = w; alturaJanela = h;
     glViewport(0, 0, w, h);
@@ -374,8 +574,143 @@ void reshape(int w, int h) {
     glMatrixMode(GL_MODELVIEW);
 }
 
-// Função principal: inicializa GLUT e inicia o loop de eventos.
+// Roda 'frames' frames pelo mesmo display() num contexto fora da tela e
+// grava as estatísticas em JSON em 'caminhoJson', ou na saída padrão (como
+// última linha) se o caminho for vazio. Com 'hashes', guarda também o hash
+// dos pixels de cada frame.
+static int executarHeadless(int frames, const std::string& caminhoJson, bool hashes) {
+    if (!criarContextoHeadless(larguraJanela, alturaJanela)) {
+        return 1;
+    }
+    modoHeadless = true;
+#ifdef BENCH_MODE
+    trace::setThreadName("headless");
+    trace::dumpAtExit("cubo_trace.json");
+#endif
+
+    init();
+    reshape(larguraJanela, alturaJanela);
+
+    // a reprodução roda pelo menos até o último evento gravado
+    if (reprodutorEntrada.reproduzindo())
+        frames = std::max(frames, (int)reprodutorEntrada.ultimoFrame() + 1);
+
+    RelatorioHeadless relatorio;
+    relatorio.largura      = larguraJanela;
+    relatorio.altura       = alturaJanela;
+    relatorio.modoRelogio  = relogio.nomeModo();
+    relatorio.passoRelogio = relogio.obterPasso();
+    relatorio.estrelas     = quantidadeEstrelas;
+    relatorio.motorEstrelas = motorInicial == MotorEstrelas::Lua    ? "lua"
+                            : motorInicial == MotorEstrelas::Nativo ? "cpp" : "gpu";
+    relatorio.threadsPool  = PoolTarefas::compartilhado().numeroThreads();
+    relatorio.temposMs.reserve(frames);
+    std::vector<unsigned char> pixels;
+    for (int i = 0; i < frames; ++i) {
+        auto inicio = std::chrono::steady_clock::now();
+        display();
+        auto fim = std::chrono::steady_clock::now();
+        relatorio.temposMs.push_back(std::chrono::duration<double, std::milli>(fim - inicio).count());
+        if (hashes)
+            relatorio.hashes.push_back(hashFramebuffer(larguraJanela, alturaJanela, pixels));
+    }
+
+#ifdef BENCH_MODE
+    gravarEstatisticasPonte();
+#endif
+
+    if (caminhoJson.empty()) {
+        imprimirEstatisticasJson(std::cout, relatorio);
+    } else {
+        std::ofstream arquivo(caminhoJson);
+        if (!arquivo) {
+            std::cerr << "Não foi possível gravar " << caminhoJson << std::endl;
+            encerrarContextoHeadless();
+            return 1;
+        }
+        imprimirEstatisticasJson(arquivo, relatorio);
+    }
+    encerrarContextoHeadless();
+    return 0;
+}
+
+// Nome do motor na linha de comando: lua, cpp ou gpu.
+static bool lerMotor(const char* nome, MotorEstrelas& motor) {
+    if (std::strcmp(nome, "lua") == 0) motor = MotorEstrelas::Lua;
+    else if (std::strcmp(nome, "cpp") == 0) motor = MotorEstrelas::Nativo;
+    else if (std::strcmp(nome, "gpu") == 0) motor = MotorEstrelas::GPU;
+    else return false;
+    return true;
+}
+
+// Função principal: inicializa GLUT e inicia o loop de eventos. Com
+// --headless [--frames N] [--json arquivo] [--hashes] roda sem janela e só
+// grava as estatísticas. --relogio parede|fixo[:segundos]|gravado:arquivo
+// escolhe o relógio da cena (headless usa passo fixo de 1/60 s por padrão)
+// e --gravar-relogio arquivo salva os instantes usados para repetir depois.
+// --gravar-entrada arquivo grava teclado, mouse e fotos por frame e
+// --reproduzir-entrada arquivo os entrega de novo nos mesmos frames.
+// --limite-memoria-lua kB limita a memória viva do lua_State.
+// --estrelas-async calcula as estrelas numa thread de simulação própria.
+// --estrelas N e --motor lua|cpp|gpu escolhem o campo de estrelas inicial e
+// --threads N o tamanho do pool de tarefas, para medir a escala no headless.
 int main(int argc, char** argv) {
+    bool headless = false;
+    bool hashes   = false;
+    int  frames   = 600;
+    std::string caminhoJson;
+    std::string modoRelogio;
+    std::string caminhoGravarEntrada, caminhoReproduzirEntrada;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            caminhoJson = argv[++i];
+        } else if (std::strcmp(argv[i], "--hashes") == 0) {
+            hashes = true;
+        } else if (std::strcmp(argv[i], "--relogio") == 0 && i + 1 < argc) {
+            modoRelogio = argv[++i];
+        } else if (std::strcmp(argv[i], "--gravar-relogio") == 0 && i + 1 < argc) {
+            relogio.gravarEm(argv[++i]);
+        } else if (std::strcmp(argv[i], "--gravar-entrada") == 0 && i + 1 < argc) {
+            caminhoGravarEntrada = argv[++i];
+        } else if (std::strcmp(argv[i], "--reproduzir-entrada") == 0 && i + 1 < argc) {
+            caminhoReproduzirEntrada = argv[++i];
+        } else if (std::strcmp(argv[i], "--estrelas-async") == 0) {
+            estrelasAsync = true;
+        } else if (std::strcmp(argv[i], "--limite-memoria-lua") == 0 && i + 1 < argc) {
+            bridge.definirLimiteMemoria((size_t)std::max(0L, std::atol(argv[++i])) * 1024);
+        } else if (std::strcmp(argv[i], "--estrelas") == 0 && i + 1 < argc) {
+            quantidadeEstrelas = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            PoolTarefas::definirThreadsCompartilhado(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--motor") == 0 && i + 1 < argc) {
+            if (!lerMotor(argv[++i], motorInicial)) {
+                std::cerr << "Motor desconhecido: " << argv[i] << " (use lua, cpp ou gpu)" << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (!caminhoGravarEntrada.empty() && !caminhoReproduzirEntrada.empty()) {
+        std::cerr << "--gravar-entrada e --reproduzir-entrada não podem ser usados juntos" << std::endl;
+        return 1;
+    }
+    if (!caminhoGravarEntrada.empty() && !gravadorEntrada.abrir(caminhoGravarEntrada)) {
+        return 1;
+    }
+    if (!caminhoReproduzirEntrada.empty() && !reprodutorEntrada.carregar(caminhoReproduzirEntrada)) {
+        return 1;
+    }
+    if (modoRelogio.empty() && headless) modoRelogio = "fixo";
+    if (!modoRelogio.empty() && !relogio.configurar(modoRelogio)) {
+        return 1;
+    }
+    if (headless) {
+        return executarHeadless(frames, caminhoJson, hashes);
+    }
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
 
@@ -390,14 +725,19 @@ int main(int argc, char** argv) {
     glutKeyboardFunc(keyboard);
     glutSpecialFunc(specialKeys);
     glutMouseFunc(mouse);
+    glutPassiveMotionFunc(passiveMotion);
     glutTimerFunc(16, timer, 0);
 
 #ifdef BENCH_MODE
+    trace::setThreadName("GLUT");
+    trace::dumpAtExit("cubo_trace.json");
+
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
-    glutInitWindowSize(400, 260);
+    glutInitWindowSize(860, 540);
     glutInitWindowPosition(920, 100);
     janelaBenchmark = glutCreateWindow("Benchmark");
     glutDisplayFunc(displayBench);
+    glutKeyboardFunc(keyboardBench);
     glutSetWindow(janelaPrincipal);
 #endif
 
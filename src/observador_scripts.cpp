@@ -0,0 +1,76 @@
+/*
+ * observador_scripts.cpp
+ */
+
+#include "observador_scripts.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+bool ObservadorScripts::observar(const std::string& dir) {
+    parar();
+    descritor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (descritor < 0) {
+        std::cerr << "inotify indisponível: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (inotify_add_watch(descritor, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cerr << "Não foi possível observar " << dir << ": " << std::strerror(errno) << std::endl;
+        parar();
+        return false;
+    }
+    diretorio = dir;
+    return true;
+}
+
+void ObservadorScripts::parar() {
+    if (descritor >= 0) close(descritor);
+    descritor = -1;
+    diretorio.clear();
+}
+
+/*
+ * Lê tudo o que estiver na fila do inotify. Um mesmo salvamento costuma
+ * gerar mais de um evento, daí a remoção de repetidos.
+ */
+void ObservadorScripts::alterados(std::vector<std::string>& nomes) {
+    nomes.clear();
+    if (descritor < 0) return;
+    alignas(inotify_event) char eventos[4096];
+    for (;;) {
+        ssize_t lidos = read(descritor, eventos, sizeof(eventos));
+        if (lidos <= 0) break;
+        for (ssize_t pos = 0; pos < lidos; ) {
+            const inotify_event* e = reinterpret_cast<const inotify_event*>(eventos + pos);
+            pos += sizeof(inotify_event) + e->len;
+            if (e->len == 0) continue;
+            std::string nome(e->name);
+            if (nome.size() < 4 || nome.compare(nome.size() - 4, 4, ".lua") != 0) continue;
+            if (std::find(nomes.begin(), nomes.end(), nome) == nomes.end())
+                nomes.push_back(nome);
+        }
+    }
+}
+
+#else
+
+bool ObservadorScripts::observar(const std::string& dir) {
+    std::cerr << "Recarga automática dos scripts só existe no Linux; " << dir << " não será observado" << std::endl;
+    return false;
+}
+
+void ObservadorScripts::parar() {
+    descritor = -1;
+    diretorio.clear();
+}
+
+void ObservadorScripts::alterados(std::vector<std::string>& nomes) {
+    nomes.clear();
+}
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * observador_scripts.h
+ *
+ * Avisa quais scripts de um diretório mudaram, para a ponte Lua
+ * recarregá-los sem reiniciar o programa. No Linux usa inotify num
+ * descritor não bloqueante: conferir a cada frame é uma leitura que volta
+ * vazia na maior parte das vezes. Em outros sistemas observar() só
+ * retorna false.
+ *
+ * Conta como mudança um arquivo .lua fechado depois de escrito ou movido
+ * para dentro do diretório, que é como os editores que salvam num arquivo
+ * temporário e renomeiam aparecem.
+ */
+
+#ifndef OBSERVADOR_SCRIPTS_H
+#define OBSERVADOR_SCRIPTS_H
+
+#include <string>
+#include <vector>
+
+class ObservadorScripts {
+private:
+    int         descritor = -1;
+    std::string diretorio;
+
+public:
+    ObservadorScripts() = default;
+    ~ObservadorScripts() { parar(); }
+    ObservadorScripts(const ObservadorScripts&) = delete;
+    ObservadorScripts& operator=(const ObservadorScripts&) = delete;
+
+    /*
+     * Passa a observar 'dir'. Retorna false, com a causa no cerr, se o
+     * diretório não puder ser observado.
+     */
+    bool observar(const std::string& dir);
+    void parar();
+    bool ativo() const { return descritor >= 0; }
+    const std::string& obterDiretorio() const { return diretorio; }
+
+    /*
+     * Troca o conteúdo de 'nomes' pelos arquivos .lua que mudaram desde a
+     * última chamada, sem repetição e sem o diretório. Não bloqueia.
+     */
+    void alterados(std::vector<std::string>& nomes);
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * pool_tarefas.cpp
+ *
+ * Filas por thread com trava própria: a disputa numa fila só acontece
+ * quando alguém rouba dela. 'pendentes' conta as tarefas em todas as filas
+ * e é o que acorda as threads paradas.
+ */
+
+#include "pool_tarefas.h"
+#include "trace.h"
+#include <algorithm>
+
+namespace {
+
+// pool e índice da thread atual, quando ela é uma thread de algum pool
+thread_local PoolTarefas* poolDaThread   = nullptr;
+thread_local int          indiceDaThread = -1;
+
+int threadsCompartilhado = 0;
+
+}
+
+PoolTarefas::PoolTarefas(int numThreads) {
+    if (numThreads <= 0)
+        numThreads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    for (int i = 0; i < numThreads; ++i)
+        filas.emplace_back(new Fila);
+    for (int i = 0; i < numThreads; ++i)
+        threads.emplace_back(&PoolTarefas::trabalhar, this, i);
+}
+
+/*
+ * Termina o que já estava agendado antes de parar as threads.
+ */
+PoolTarefas::~PoolTarefas() {
+    {
+        std::lock_guard<std::mutex> trava(mutexSono);
+        encerrando = true;
+    }
+    cvSono.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+PoolTarefas& PoolTarefas::compartilhado() {
+    static PoolTarefas* pool = new PoolTarefas(threadsCompartilhado);
+    return *pool;
+}
+
+void PoolTarefas::definirThreadsCompartilhado(int numThreads) {
+    threadsCompartilhado = numThreads;
+}
+
+void PoolTarefas::enviar(Tarefa tarefa) {
+    int n = (int)filas.size();
+    int destino = (poolDaThread == this) ? indiceDaThread
+                                         : (int)(proximaFila.fetch_add(1, std::memory_order_relaxed) % n);
+    {
+        std::lock_guard<std::mutex> trava(filas[destino]->mutex);
+        filas[destino]->tarefas.push_back(std::move(tarefa));
+    }
+    {
+        std::lock_guard<std::mutex> trava(mutexSono);
+        ++pendentes;
+    }
+    cvSono.notify_one();
+}
+
+/*
+ * Fim da própria fila primeiro; depois o começo das outras, a partir da
+ * vizinha, para as threads não roubarem todas da mesma.
+ */
+bool PoolTarefas::pegar(int indice, Tarefa& tarefa) {
+    int n = (int)filas.size();
+    for (int k = 0; k < n; ++k) {
+        Fila& fila = *filas[(indice + k) % n];
+        std::lock_guard<std::mutex> trava(fila.mutex);
+        if (fila.tarefas.empty()) continue;
+        if (k == 0) {
+            tarefa = std::move(fila.tarefas.back());
+            fila.tarefas.pop_back();
+        } else {
+            tarefa = std::move(fila.tarefas.front());
+            fila.tarefas.pop_front();
+            roubadas.fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    return false;
+}
+
+void PoolTarefas::trabalhar(int indice) {
+    poolDaThread   = this;
+    indiceDaThread = indice;
+#ifdef BENCH_MODE
+    trace::setThreadName("pool de tarefas");
+#endif
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> trava(mutexSono);
+            cvSono.wait(trava, [this] { return encerrando || pendentes > 0; });
+            if (pendentes == 0) return;
+            --pendentes;
+        }
+        // a tarefa contada pode ter sido pega por outra thread que passou
+        // na frente; nesse caso há outra na fila que ninguém contou ainda
+        Tarefa tarefa;
+        while (!pegar(indice, tarefa)) std::this_thread::yield();
+        tarefa();
+        executadas.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/*
+ * Os blocos saem de um contador atômico compartilhado: cada ajudante
+ * enviado ao pool e a própria thread pegam o próximo bloco livre até
+ * acabarem. O estado fica num shared_ptr porque um ajudante pode começar
+ * depois que todos os blocos já terminaram e a função já voltou.
+ */
+void PoolTarefas::paraCada(int blocos, const std::function<void(int)>& f) {
+    if (blocos <= 0) return;
+    if (blocos == 1) { f(0); return; }
+
+    struct Estado {
+        std::atomic<int> proximo{0};
+        std::atomic<int> feitos{0};
+        int blocos;
+        const std::function<void(int)>* f;
+    };
+    auto estado = std::make_shared<Estado>();
+    estado->blocos = blocos;
+    estado->f      = &f;
+
+    auto executarBlocos = [](Estado& e) {
+        int b;
+        while ((b = e.proximo.fetch_add(1, std::memory_order_relaxed)) < e.blocos) {
+            (*e.f)(b);
+            e.feitos.fetch_add(1, std::memory_order_release);
+        }
+    };
+
+    int ajudantes = std::min(blocos - 1, numeroThreads());
+    for (int i = 0; i < ajudantes; ++i)
+        enviar([estado, executarBlocos] { executarBlocos(*estado); });
+
+    executarBlocos(*estado);
+    while (estado->feitos.load(std::memory_order_acquire) < blocos)
+        std::this_thread::yield();
+}
@@ -0,0 +1,88 @@
+/*
+ * pool_tarefas.h
+ *
+ * Pool de threads com roubo de tarefas, compartilhado pelo programa: o
+ * cálculo das estrelas em blocos e a decodificação das fotos rodam nas
+ * mesmas threads. Cada thread tem a sua fila; tira tarefas do fim da
+ * própria (a mais recente, ainda quente no cache) e, quando ela esvazia,
+ * rouba do começo da fila das outras. Tarefas enviadas de fora do pool são
+ * distribuídas entre as filas em rodízio.
+ *
+ * paraCada divide um trabalho em blocos e espera todos terminarem. A thread
+ * que chama também pega blocos, então o trabalho anda mesmo com todas as
+ * threads do pool ocupadas com tarefas longas, e chamar de dentro de uma
+ * tarefa não trava.
+ */
+
+#ifndef POOL_TAREFAS_H
+#define POOL_TAREFAS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PoolTarefas {
+public:
+    using Tarefa = std::function<void()>;
+
+    /*
+     * 'threads' <= 0 usa uma thread a menos que os núcleos da máquina (a
+     * thread que chama paraCada é a que falta), com no mínimo uma.
+     */
+    explicit PoolTarefas(int threads = 0);
+    ~PoolTarefas();
+
+    PoolTarefas(const PoolTarefas&) = delete;
+    PoolTarefas& operator=(const PoolTarefas&) = delete;
+
+    /*
+     * Pool usado por todo o programa, criado no primeiro uso com o número
+     * de threads de definirThreadsCompartilhado (ou o padrão). Nunca é
+     * destruído: as threads param com o processo.
+     */
+    static PoolTarefas& compartilhado();
+    static void definirThreadsCompartilhado(int threads);
+
+    /*
+     * Agenda 'tarefa' e volta sem esperar.
+     */
+    void enviar(Tarefa tarefa);
+
+    /*
+     * Chama f(0) ... f(blocos - 1) espalhados pelo pool e pela thread atual
+     * e só volta quando todos terminaram. Os blocos não têm ordem definida.
+     */
+    void paraCada(int blocos, const std::function<void(int)>& f);
+
+    int numeroThreads() const { return (int)threads.size(); }
+    unsigned long long tarefasExecutadas() const { return executadas.load(std::memory_order_relaxed); }
+    unsigned long long tarefasRoubadas() const { return roubadas.load(std::memory_order_relaxed); }
+
+private:
+    struct Fila {
+        std::mutex         mutex;
+        std::deque<Tarefa> tarefas;
+    };
+
+    std::vector<std::unique_ptr<Fila>> filas;
+    std::vector<std::thread>           threads;
+
+    std::mutex              mutexSono;
+    std::condition_variable cvSono;
+    int                     pendentes  = 0;
+    bool                    encerrando = false;
+
+    std::atomic<unsigned>           proximaFila{0};
+    std::atomic<unsigned long long> executadas{0};
+    std::atomic<unsigned long long> roubadas{0};
+
+    bool pegar(int indice, Tarefa& tarefa);
+    void trabalhar(int indice);
+};
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * relogio.cpp
+ *
+ * Implementação do relógio da cena e da gravação dos instantes.
+ */
+
+#include "relogio.h"
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <iostream>
+
+Relogio::Relogio()
+    : modo(ModoRelogio::Parede), passo(1.0 / 60.0), tempo(0.0), deltaFrame(0.0),
+      frame(-1), inicio(std::chrono::steady_clock::now()) {}
+
+Relogio::~Relogio() {
+    if (caminhoGravacao.empty()) return;
+    std::ofstream arquivo(caminhoGravacao);
+    if (!arquivo) {
+        std::cerr << "Não foi possível gravar o relógio em " << caminhoGravacao << std::endl;
+        return;
+    }
+    arquivo << std::setprecision(17);
+    for (double t : gravacao) arquivo << t << '\n';
+}
+
+void Relogio::usarParede() {
+    modo = ModoRelogio::Parede;
+}
+
+void Relogio::usarPassoFixo(double passoSegundos) {
+    modo  = ModoRelogio::PassoFixo;
+    passo = passoSegundos > 0.0 ? passoSegundos : 1.0 / 60.0;
+}
+
+bool Relogio::usarGravado(const std::string& caminho) {
+    std::ifstream arquivo(caminho);
+    if (!arquivo) {
+        std::cerr << "Relógio gravado não encontrado: " << caminho << std::endl;
+        return false;
+    }
+    std::vector<double> lidos;
+    double t = 0.0;
+    while (arquivo >> t) lidos.push_back(t);
+    if (lidos.empty()) {
+        std::cerr << "Relógio gravado vazio: " << caminho << std::endl;
+        return false;
+    }
+    instantesGravados.swap(lidos);
+    modo = ModoRelogio::Gravado;
+    return true;
+}
+
+bool Relogio::configurar(const std::string& especificacao) {
+    if (especificacao == "parede") {
+        usarParede();
+        return true;
+    }
+    if (especificacao == "fixo") {
+        usarPassoFixo(1.0 / 60.0);
+        return true;
+    }
+    if (especificacao.rfind("fixo:", 0) == 0) {
+        usarPassoFixo(std::atof(especificacao.c_str() + 5));
+        return true;
+    }
+    if (especificacao.rfind("gravado:", 0) == 0) {
+        return usarGravado(especificacao.substr(8));
+    }
+    std::cerr << "Modo de relógio desconhecido: " << especificacao << std::endl;
+    return false;
+}
+
+void Relogio::iniciarFrame() {
+    ++frame;
+    double anterior = tempo;
+
+    switch (modo) {
+        case ModoRelogio::Parede:
+            tempo = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+            if (frame == 0) {
+                inicio = std::chrono::steady_clock::now();
+                tempo  = 0.0;
+            }
+            break;
+        case ModoRelogio::PassoFixo:
+            tempo = frame * passo;
+            break;
+        case ModoRelogio::Gravado: {
+            size_t n = instantesGravados.size();
+            if ((size_t)frame < n) {
+                tempo = instantesGravados[frame];
+            } else {
+                double ultimoPasso = n >= 2 ? instantesGravados[n - 1] - instantesGravados[n - 2] : passo;
+                tempo = instantesGravados[n - 1] + ultimoPasso * (double)(frame - (long)n + 1);
+            }
+            break;
+        }
+    }
+
+    deltaFrame = frame == 0 ? 0.0 : tempo - anterior;
+    if (!caminhoGravacao.empty()) gravacao.push_back(tempo);
+}
+
+const char* Relogio::nomeModo() const {
+    switch (modo) {
+        case ModoRelogio::Parede:    return "parede";
+        case ModoRelogio::PassoFixo: return "fixo";
+        case ModoRelogio::Gravado:   return "gravado";
+    }
+    return "?";
+}
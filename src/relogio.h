@@ -0,0 +1,84 @@
+/*
+ * relogio.h
+ *
+ * Relógio da cena. Tudo que depende do tempo (estrelas, bench, modo
+ * headless) lê daqui em vez do relógio de parede, e o tempo só avança em
+ * iniciarFrame(), uma vez por frame. Três modos:
+ *
+ *   parede     — segundos reais desde o início, como antes;
+ *   passo fixo — cada frame avança exatamente 'passo' segundos, então duas
+ *                execuções desenham os mesmos frames;
+ *   gravado    — repete os instantes gravados de uma execução anterior
+ *                (um por linha, em segundos).
+ *
+ * Em qualquer modo os instantes usados podem ser gravados num arquivo para
+ * repetição posterior.
+ */
+
+#ifndef RELOGIO_H
+#define RELOGIO_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+enum class ModoRelogio {
+    Parede,
+    PassoFixo,
+    Gravado
+};
+
+class Relogio {
+private:
+    ModoRelogio modo;
+    double passo;
+    double tempo;
+    double deltaFrame;
+    long   frame;
+    std::chrono::steady_clock::time_point inicio;
+
+    std::vector<double> instantesGravados;
+    std::vector<double> gravacao;
+    std::string caminhoGravacao;
+
+public:
+    Relogio();
+    ~Relogio();
+
+    void usarParede();
+    void usarPassoFixo(double passoSegundos);
+
+    /*
+     * Lê os instantes de 'caminho'. Retorna false (e mantém o modo atual)
+     * se o arquivo não abrir ou estiver vazio. Quando os instantes acabam,
+     * o relógio segue com o último intervalo gravado.
+     */
+    bool usarGravado(const std::string& caminho);
+
+    /*
+     * Interpreta uma especificação de linha de comando: "parede",
+     * "fixo" (1/60 s), "fixo:<segundos>" ou "gravado:<arquivo>".
+     */
+    bool configurar(const std::string& especificacao);
+
+    /*
+     * Grava o instante de cada frame em 'caminho' quando o relógio é
+     * destruído (na saída do programa).
+     */
+    void gravarEm(const std::string& caminho) { caminhoGravacao = caminho; }
+
+    /*
+     * Avança para o próximo frame. O primeiro frame é sempre o instante 0
+     * nos modos parede e passo fixo.
+     */
+    void iniciarFrame();
+
+    double agora() const { return tempo; }
+    double delta() const { return deltaFrame; }
+    long   numeroFrame() const { return frame; }
+    ModoRelogio obterModo() const { return modo; }
+    double obterPasso() const { return passo; }
+    const char* nomeModo() const;
+};
+
+#endif
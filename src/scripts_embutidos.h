@@ -0,0 +1,26 @@
+/*
+ * scripts_embutidos.h
+ *
+ * Os scripts de lua/ compilados para bytecode e embutidos no binário. A
+ * tabela é gerada pelo make (tools/embutir_lua.cpp) sempre que um script
+ * de lua/ muda, com o mesmo Lua que o programa usa, então o bytecode
+ * sempre bate com a versão da biblioteca. Um script que não compila na hora do
+ * build entra como texto e o erro aparece no init, como antes.
+ */
+
+#ifndef SCRIPTS_EMBUTIDOS_H
+#define SCRIPTS_EMBUTIDOS_H
+
+#include <cstddef>
+
+struct ScriptEmbutido {
+    const char*          nome;       // nome do arquivo, sem o diretório
+    const unsigned char* dados;
+    size_t               tamanho;
+    bool                 bytecode;   // false: texto do script
+};
+
+extern const ScriptEmbutido scriptsEmbutidos[];
+extern const int            quantidadeScriptsEmbutidos;
+
+#endif
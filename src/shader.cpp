@@ -0,0 +1,66 @@
+/*
+ * shader.cpp
+ *
+ * Compila cada estágio, liga o programa e descarta os objetos de shader,
+ * que não são mais necessários depois do link. Os logs de erro vão para
+ * std::cerr, como os erros de Lua no bridge.
+ */
+
+#include "shader.h"
+#include <iostream>
+#include <vector>
+
+namespace {
+
+GLuint compilarEstagio(const char* nome, GLenum tipo, const char* fonte) {
+    GLuint sh = glCreateShader(tipo);
+    glShaderSource(sh, 1, &fonte, nullptr);
+    glCompileShader(sh);
+
+    GLint ok = GL_FALSE;
+    glGetShaderiv(sh, GL_COMPILE_STATUS, &ok);
+    if (ok != GL_TRUE) {
+        GLint tamanho = 0;
+        glGetShaderiv(sh, GL_INFO_LOG_LENGTH, &tamanho);
+        std::vector<char> log(tamanho > 1 ? tamanho : 1, '\0');
+        glGetShaderInfoLog(sh, (GLsizei)log.size(), nullptr, log.data());
+        std::cerr << "Erro ao compilar shader " << nome
+                  << (tipo == GL_VERTEX_SHADER ? " (vertex): " : " (fragment): ")
+                  << log.data() << std::endl;
+        glDeleteShader(sh);
+        return 0;
+    }
+    return sh;
+}
+
+}
+
+GLuint compilarPrograma(const char* nome, const char* fonteVertice, const char* fonteFragmento) {
+    GLuint vs = compilarEstagio(nome, GL_VERTEX_SHADER, fonteVertice);
+    if (!vs) return 0;
+    GLuint fs = compilarEstagio(nome, GL_FRAGMENT_SHADER, fonteFragmento);
+    if (!fs) {
+        glDeleteShader(vs);
+        return 0;
+    }
+
+    GLuint prog = glCreateProgram();
+    glAttachShader(prog, vs);
+    glAttachShader(prog, fs);
+    glLinkProgram(prog);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    if (ok != GL_TRUE) {
+        GLint tamanho = 0;
+        glGetProgramiv(prog, GL_INFO_LOG_LENGTH, &tamanho);
+        std::vector<char> log(tamanho > 1 ? tamanho : 1, '\0');
+        glGetProgramInfoLog(prog, (GLsizei)log.size(), nullptr, log.data());
+        std::cerr << "Erro ao ligar programa " << nome << ": " << log.data() << std::endl;
+        glDeleteProgram(prog);
+        return 0;
+    }
+    return prog;
+}
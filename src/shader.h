@@ -0,0 +1,21 @@
+/*
+ * shader.h
+ *
+ * Compilação de programas GLSL. Os shaders do projeto usam GLSL 1.20 e as
+ * entradas embutidas do pipeline fixo (gl_Vertex, gl_Color, gl_MultiTexCoord0),
+ * então convivem com o resto do desenho em modo imediato sem VAO nem
+ * atributos genéricos.
+ */
+
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <GL/glut.h>
+
+/*
+ * Compila e liga um programa com um vertex e um fragment shader. Em caso de
+ * erro imprime o log do driver com o nome dado e retorna 0.
+ */
+GLuint compilarPrograma(const char* nome, const char* fonteVertice, const char* fonteFragmento);
+
+#endif
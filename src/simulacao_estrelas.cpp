@@ -0,0 +1,108 @@
+/*
+ * simulacao_estrelas.cpp
+ *
+ * Laço da thread de simulação. O pedido (instante, motor e uma eventual
+ * nova quantidade de estrelas) passa por uma trava curta; os quadros
+ * prontos voltam pelo TriploBuffer, sem trava.
+ */
+
+#include "simulacao_estrelas.h"
+#include "estrelas_nativo.h"
+#include "lua_bridge.h"
+#include "trace.h"
+
+// tempo dado à coleta do Lua da simulação depois de cada quadro
+static const double ORCAMENTO_GC_SIMULACAO_US = 1000.0;
+
+void SimulacaoEstrelas::iniciar() {
+    if (thread.joinable()) return;
+    encerrando = false;
+    thread = std::thread(&SimulacaoEstrelas::executar, this);
+}
+
+void SimulacaoEstrelas::encerrar() {
+    if (!thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> trava(mutexPedido);
+        encerrando = true;
+    }
+    cvPedido.notify_one();
+    thread.join();
+}
+
+void SimulacaoEstrelas::inicializarEstrelas(int quantidade) {
+    {
+        std::lock_guard<std::mutex> trava(mutexPedido);
+        quantidadeNova = quantidade;
+    }
+    cvPedido.notify_one();
+}
+
+void SimulacaoEstrelas::pedir(float tempo, MotorEstrelas motor) {
+    {
+        std::lock_guard<std::mutex> trava(mutexPedido);
+        temPedido   = true;
+        tempoPedido = tempo;
+        motorPedido = motor;
+    }
+    cvPedido.notify_one();
+}
+
+const QuadroEstrelas* SimulacaoEstrelas::ultimoQuadro() {
+    quadros.atualizar();
+    return quadros.temQuadro() ? &quadros.paraLer() : nullptr;
+}
+
+/*
+ * A ponte Lua da thread nasce e morre aqui dentro, então o lua_State só é
+ * tocado por esta thread. Se os scripts não carregarem, o motor Lua cai no
+ * cálculo em C++, que gera as mesmas estrelas.
+ */
+void SimulacaoEstrelas::executar() {
+#ifdef BENCH_MODE
+    trace::setThreadName("simulação das estrelas");
+#endif
+    LuaBridge ponte;
+    bool luaOk = ponte.init();
+    CampoEstrelas campo;
+
+    for (;;) {
+        bool calcular;
+        float tempo;
+        MotorEstrelas motor;
+        int quantidade;
+        {
+            std::unique_lock<std::mutex> trava(mutexPedido);
+            cvPedido.wait(trava, [this] { return encerrando || temPedido || quantidadeNova >= 0; });
+            if (encerrando) return;
+            calcular       = temPedido;
+            tempo          = tempoPedido;
+            motor          = motorPedido;
+            quantidade     = quantidadeNova;
+            temPedido      = false;
+            quantidadeNova = -1;
+        }
+
+        // a ponte desta thread observa os mesmos scripts que a principal
+        if (luaOk) ponte.recarregarAlterados();
+
+        if (quantidade >= 0) {
+            TRACE_SCOPE("SimulacaoEstrelas::inicializar");
+            if (luaOk) ponte.inicializarEstrelas(quantidade);
+            campo.inicializar(quantidade);
+        }
+        if (!calcular) continue;
+
+        QuadroEstrelas& quadro = quadros.paraEscrever();
+        quadro.tempo = tempo;
+        if (motor == MotorEstrelas::Lua && luaOk) {
+            ponte.obterPosicoesEstrelas(tempo, quadro.vertices);
+        } else {
+            TRACE_SCOPE("CampoEstrelas::calcular");
+            campo.calcular(tempo, quadro.vertices);
+        }
+        quadros.publicar();
+
+        if (luaOk) ponte.passoColetor(ORCAMENTO_GC_SIMULACAO_US);
+    }
+}
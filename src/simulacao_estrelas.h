@@ -0,0 +1,80 @@
+/*
+ * simulacao_estrelas.h
+ *
+ * Cálculo das estrelas fora da thread do GLUT. A thread de simulação tem o
+ * seu próprio LuaBridge (e portanto o seu lua_State) e o seu CampoEstrelas;
+ * a cada pedido ela calcula as posições para o instante pedido no motor
+ * pedido e publica o quadro num TriploBuffer. O Background pede o instante
+ * do frame atual e desenha o último quadro pronto, normalmente o do frame
+ * anterior: o cálculo de um frame corre junto com o desenho do outro e um
+ * frame lento no Lua não segura a troca de buffers.
+ *
+ * Só os motores de CPU (Lua e C++) passam por aqui; o motor de GPU não
+ * calcula nada por frame.
+ */
+
+#ifndef SIMULACAO_ESTRELAS_H
+#define SIMULACAO_ESTRELAS_H
+
+#include "background.h"
+#include "triplo_buffer.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct QuadroEstrelas {
+    float tempo;
+    std::vector<float> vertices;
+};
+
+class SimulacaoEstrelas {
+private:
+    std::thread thread;
+
+    std::mutex              mutexPedido;
+    std::condition_variable cvPedido;
+    bool          encerrando   = false;
+    bool          temPedido    = false;
+    float         tempoPedido  = 0.0f;
+    MotorEstrelas motorPedido  = MotorEstrelas::Lua;
+    int           quantidadeNova = -1;
+
+    TriploBuffer<QuadroEstrelas> quadros;
+
+    void executar();
+
+public:
+    SimulacaoEstrelas() = default;
+    ~SimulacaoEstrelas() { encerrar(); }
+    SimulacaoEstrelas(const SimulacaoEstrelas&) = delete;
+    SimulacaoEstrelas& operator=(const SimulacaoEstrelas&) = delete;
+
+    /*
+     * Sobe a thread de simulação. O lua_State dela é criado lá dentro, na
+     * primeira volta do laço.
+     */
+    void iniciar();
+    void encerrar();
+    bool ativa() const { return thread.joinable(); }
+
+    /*
+     * Gera as estrelas de novo nos dois motores da thread, antes do próximo
+     * pedido.
+     */
+    void inicializarEstrelas(int quantidade);
+
+    /*
+     * Pede o quadro do instante 'tempo'. Um pedido que a thread ainda não
+     * começou é substituído pelo novo.
+     */
+    void pedir(float tempo, MotorEstrelas motor);
+
+    /*
+     * Último quadro pronto, ou nullptr se nenhum ficou pronto ainda. Só a
+     * thread que desenha chama; o ponteiro vale até a próxima chamada.
+     */
+    const QuadroEstrelas* ultimoQuadro();
+};
+
+#endif
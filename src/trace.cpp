@@ -0,0 +1,165 @@
+/*
+ * trace.cpp
+ *
+ * Buffers por thread do trace. Cada thread cria o seu no primeiro evento e
+ * o encadeia numa lista global com compare-and-swap; a lista só cresce e os
+ * buffers nunca são liberados, então o dump pode percorrê-la sem trava
+ * mesmo com threads já encerradas.
+ */
+
+#ifdef BENCH_MODE
+
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace trace {
+
+namespace {
+
+constexpr uint32_t CAPACITY  = 1u << 16;
+constexpr int      MAX_DEPTH = 64;
+
+struct Event {
+    const char* name;
+    uint64_t    startNs;
+    uint64_t    durNs;
+};
+
+struct ThreadBuffer {
+    Event                 events[CAPACITY];
+    std::atomic<uint32_t> written{0};
+    std::atomic<const char*> threadName{nullptr};
+    uint64_t              tid = 0;
+    ThreadBuffer*         next = nullptr;
+
+    const char* openName[MAX_DEPTH];
+    uint64_t    openStart[MAX_DEPTH];
+    int         depth = 0;
+};
+
+std::atomic<ThreadBuffer*> gHead{nullptr};
+std::atomic<uint64_t>      gNextTid{1};
+std::string                gExitPath;
+
+const auto gEpoch = std::chrono::steady_clock::now();
+
+uint64_t nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - gEpoch).count();
+}
+
+ThreadBuffer* localBuffer() {
+    thread_local ThreadBuffer* buf = nullptr;
+    if (!buf) {
+        buf = new ThreadBuffer();
+        buf->tid  = gNextTid++;
+        buf->next = gHead.load(std::memory_order_relaxed);
+        while (!gHead.compare_exchange_weak(buf->next, buf,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {}
+    }
+    return buf;
+}
+
+void writeEscaped(FILE* f, const char* s) {
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        fputc(*s, f);
+    }
+}
+
+void dumpOnExit() {
+    if (!gExitPath.empty()) dump(gExitPath.c_str());
+}
+
+}
+
+void begin(const char* name) {
+    ThreadBuffer* b = localBuffer();
+    if (b->depth < MAX_DEPTH) {
+        b->openName[b->depth]  = name;
+        b->openStart[b->depth] = nowNs();
+    }
+    ++b->depth;
+}
+
+/*
+ * Escopos além de MAX_DEPTH só contam profundidade e não geram evento.
+ */
+void end() {
+    ThreadBuffer* b = localBuffer();
+    if (b->depth == 0) return;
+    --b->depth;
+    if (b->depth >= MAX_DEPTH) return;
+
+    uint32_t n = b->written.load(std::memory_order_relaxed);
+    uint64_t start = b->openStart[b->depth];
+    b->events[n % CAPACITY] = {b->openName[b->depth], start, nowNs() - start};
+    b->written.store(n + 1, std::memory_order_release);
+}
+
+void setThreadName(const char* name) {
+    localBuffer()->threadName.store(name, std::memory_order_release);
+}
+
+bool dump(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "trace: não foi possível abrir %s\n", path);
+        return false;
+    }
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    std::vector<Event> copy;
+    for (ThreadBuffer* b = gHead.load(std::memory_order_acquire); b; b = b->next) {
+        const char* tname = b->threadName.load(std::memory_order_acquire);
+        if (tname) {
+            fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%llu,\"args\":{\"name\":\"",
+                    first ? "" : ",\n", (unsigned long long)b->tid);
+            writeEscaped(f, tname);
+            fprintf(f, "\"}}");
+            first = false;
+        }
+        /*
+         * a thread dona continua gravando durante o dump. os eventos são
+         * copiados primeiro e 'written' é lido de novo depois: o que ela
+         * gravou no meio pode ter sobrescrito os slots até o do evento
+         * after - CAPACITY (o último ainda em andamento), e esses saem da
+         * cópia em vez de ir para o arquivo com campos misturados.
+         */
+        uint32_t n      = b->written.load(std::memory_order_acquire);
+        uint32_t oldest = (n > CAPACITY) ? n - CAPACITY : 0;
+        copy.resize(n - oldest);
+        for (uint32_t i = oldest; i < n; ++i) copy[i - oldest] = b->events[i % CAPACITY];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t after = b->written.load(std::memory_order_relaxed);
+        uint32_t begin = (after >= CAPACITY && after - CAPACITY + 1 > oldest)
+                       ? after - CAPACITY + 1 : oldest;
+        for (uint32_t i = begin; i < n; ++i) {
+            const Event& e = copy[i - oldest];
+            fprintf(f, "%s{\"ph\":\"X\",\"name\":\"", first ? "" : ",\n");
+            writeEscaped(f, e.name);
+            fprintf(f, "\",\"pid\":1,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f}",
+                    (unsigned long long)b->tid, e.startNs / 1000.0, e.durNs / 1000.0);
+            first = false;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    return true;
+}
+
+void dumpAtExit(const char* path) {
+    bool registered = !gExitPath.empty();
+    gExitPath = path;
+    if (!registered) std::atexit(dumpOnExit);
+}
+
+}
+
+#endif /* BENCH_MODE */
@@ -0,0 +1,65 @@
+/*
+ * trace.h
+ *
+ * Registro de escopos aninhados no formato de trace do Chrome
+ * (chrome://tracing / Perfetto). Cada thread grava num buffer próprio, sem
+ * trava: só a thread dona escreve, e o dump apenas lê. Cada escopo vira um
+ * evento completo ("X") com início e duração, gravado quando o escopo
+ * fecha; quando o buffer enche, os eventos mais antigos são sobrescritos.
+ *
+ * Só existe no build de bench. Fora dele TRACE_SCOPE não gera código.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef BENCH_MODE
+
+#include <cstdint>
+
+namespace trace {
+
+/*
+ * Abre e fecha um escopo na thread atual. 'name' precisa durar o programa
+ * inteiro (um literal), porque só o ponteiro é guardado.
+ */
+void begin(const char* name);
+void end();
+
+/*
+ * Nome da thread atual no trace; também precisa ser um literal.
+ */
+void setThreadName(const char* name);
+
+/*
+ * Escreve os eventos de todas as threads em 'path' como JSON. Pode ser
+ * chamado a qualquer momento; eventos gravados durante o dump podem ou não
+ * entrar nele, e os que forem sobrescritos enquanto ele copia ficam de
+ * fora. Retorna false se o arquivo não abriu.
+ */
+bool dump(const char* path);
+
+/*
+ * Registra um dump automático em 'path' na saída do programa (atexit).
+ */
+void dumpAtExit(const char* path);
+
+struct Scope {
+    explicit Scope(const char* name) { begin(name); }
+    ~Scope() { end(); }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+};
+
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name)   trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name)   ((void)0)
+
+#endif /* BENCH_MODE */
+#endif /* TRACE_H */
@@ -0,0 +1,65 @@
+/*
+ * triplo_buffer.h
+ *
+ * Troca de quadros entre uma thread que produz e uma que consome, sem
+ * trava. São três cópias de T: uma é escrita pelo produtor, uma é lida pelo
+ * consumidor e a do meio guarda o último quadro publicado. Publicar e
+ * pegar o mais novo são uma troca atômica do índice do meio cada; nenhum
+ * lado espera pelo outro e o consumidor sempre vê um quadro inteiro.
+ *
+ * Quadros publicados que o consumidor não chegou a pegar são simplesmente
+ * substituídos pelo seguinte.
+ */
+
+#ifndef TRIPLO_BUFFER_H
+#define TRIPLO_BUFFER_H
+
+#include <atomic>
+
+template <class T>
+class TriploBuffer {
+private:
+    static constexpr unsigned INDICE = 3;
+    static constexpr unsigned NOVO   = 4;
+
+    T quadros[3];
+    std::atomic<unsigned> meio{1};
+    unsigned escrita = 0;   // só o produtor mexe
+    unsigned leitura = 2;   // só o consumidor mexe
+    bool     recebeu = false;
+
+public:
+    /*
+     * Produtor: quadro a preencher. O conteúdo é o de um quadro antigo,
+     * então vetores já vêm com a capacidade de antes.
+     */
+    T& paraEscrever() { return quadros[escrita]; }
+
+    /*
+     * Produtor: torna o quadro escrito o mais novo e passa a escrever no
+     * que estava no meio.
+     */
+    void publicar() {
+        escrita = meio.exchange(escrita | NOVO, std::memory_order_acq_rel) & INDICE;
+    }
+
+    /*
+     * Consumidor: pega o último quadro publicado, se houver um que ainda
+     * não foi pego. Retorna true se o quadro de leitura mudou.
+     */
+    bool atualizar() {
+        if (!(meio.load(std::memory_order_acquire) & NOVO)) return false;
+        leitura = meio.exchange(leitura, std::memory_order_acq_rel) & INDICE;
+        recebeu = true;
+        return true;
+    }
+
+    /*
+     * Consumidor: quadro atual, válido até o próximo atualizar(). Antes do
+     * primeiro quadro publicado, temQuadro() é false.
+     */
+    const T& paraLer() const { return quadros[leitura]; }
+    bool temQuadro() const { return recebeu; }
+};
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * embutir_lua.cpp
+ *
+ * Gerador usado pelo make: compila cada script com luaL_loadfile, guarda o
+ * bytecode com lua_dump e escreve um .cpp com a tabela de
+ * scripts_embutidos.h. Roda com a mesma biblioteca Lua que o programa,
+ * então não depende de um luac da mesma versão instalado na máquina.
+ *
+ *   embutir_lua saida.cpp lua/background.lua lua/mixer.lua ...
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+extern "C" {
+    #include <lua.h>
+    #include <lualib.h>
+    #include <lauxlib.h>
+}
+
+static int escreverBytes(lua_State*, const void* p, size_t n, void* ud) {
+    std::vector<unsigned char>* dados = (std::vector<unsigned char>*)ud;
+    const unsigned char* bytes = (const unsigned char*)p;
+    dados->insert(dados->end(), bytes, bytes + n);
+    return 0;
+}
+
+static std::string nomeDoArquivo(const std::string& caminho) {
+    size_t barra = caminho.find_last_of("/\\");
+    return barra == std::string::npos ? caminho : caminho.substr(barra + 1);
+}
+
+/*
+ * bytecode do script, ou o texto dele se não compilar: o erro de sintaxe
+ * fica para o init do programa mostrar, e o build não para por causa dele.
+ */
+static bool compilar(const std::string& caminho, std::vector<unsigned char>& dados, bool& bytecode) {
+    lua_State* L = luaL_newstate();
+    if (!L) return false;
+    int status = luaL_loadfile(L, caminho.c_str());
+    if (status == LUA_OK) {
+        lua_dump(L, escreverBytes, &dados, 0);
+        bytecode = true;
+    } else {
+        std::cerr << "embutir_lua: " << lua_tostring(L, -1) << " (embutido como texto)" << std::endl;
+        std::ifstream arquivo(caminho, std::ios::binary);
+        if (!arquivo) {
+            lua_close(L);
+            return false;
+        }
+        dados.assign(std::istreambuf_iterator<char>(arquivo), std::istreambuf_iterator<char>());
+        bytecode = false;
+    }
+    lua_close(L);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "uso: embutir_lua saida.cpp script.lua..." << std::endl;
+        return 1;
+    }
+    FILE* saida = std::fopen(argv[1], "w");
+    if (!saida) {
+        std::cerr << "embutir_lua: não foi possível gravar " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::fprintf(saida, "// gerado por tools/embutir_lua.cpp; não editar\n");
+    std::fprintf(saida, "#include \"scripts_embutidos.h\"\n\n");
+
+    std::vector<std::string> nomes;
+    std::vector<bool> bytecodes;
+    for (int i = 2; i < argc; ++i) {
+        std::vector<unsigned char> dados;
+        bool bytecode = false;
+        if (!compilar(argv[i], dados, bytecode)) {
+            std::cerr << "embutir_lua: não foi possível ler " << argv[i] << std::endl;
+            std::fclose(saida);
+            std::remove(argv[1]);
+            return 1;
+        }
+        std::fprintf(saida, "static const unsigned char script%d[] = {", i - 2);
+        for (size_t k = 0; k < dados.size(); ++k)
+            std::fprintf(saida, "%s%u,", k % 20 ? "" : "\n    ", dados[k]);
+        std::fprintf(saida, "\n};\n\n");
+        nomes.push_back(nomeDoArquivo(argv[i]));
+        bytecodes.push_back(bytecode);
+    }
+
+    std::fprintf(saida, "const ScriptEmbutido scriptsEmbutidos[] = {\n");
+    for (size_t i = 0; i < nomes.size(); ++i)
+        std::fprintf(saida, "    {\"%s\", script%zu, sizeof(script%zu), %s},\n",
+                     nomes[i].c_str(), i, i, bytecodes[i] ? "true" : "false");
+    if (nomes.empty())
+        std::fprintf(saida, "    {nullptr, nullptr, 0, false},\n");
+    std::fprintf(saida, "};\n\nconst int quantidadeScriptsEmbutidos = %zu;\n", nomes.size());
+
+    bool ok = std::fclose(saida) == 0;
+    if (!ok) std::remove(argv[1]);
+    return ok ? 0 : 1;
+}
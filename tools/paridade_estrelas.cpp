@@ -0,0 +1,172 @@
+/*
+ * paridade_estrelas.cpp
+ *
+ * Verificação usada pelo make check: roda obterPosicoesEstrelas de
+ * background.lua (seed 1337) e cada caminho do CampoEstrelas que a CPU
+ * suporta (avx2, sse2 e escalar), cada um numa thread só e dividido no
+ * PoolTarefas, nos mesmos instantes, e compara x, y, r, g e b estrela a
+ * estrela. Não abre janela nem precisa de contexto GL, e por isso o motor
+ * de GPU fica de fora. Sai com 1 se algum valor passar da tolerância.
+ *
+ * O campo tem pelo menos MINIMO_PARALELO estrelas mais meio bloco, para
+ * que o pool divida de verdade e o último bloco fique incompleto.
+ *
+ *   paridade_estrelas lua/background.lua [instantes] [estrelas]
+ */
+
+#include "estrelas_nativo.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+extern "C" {
+    #include <lua.h>
+    #include <lualib.h>
+    #include <lauxlib.h>
+}
+
+/*
+ * erro máximo aceito entre o Lua (double) e os kernels (float) em cada
+ * campo, com folga de ~6x sobre o pior visto em 600 instantes (3.5e-6 em x
+ * e y perto de t = 440 s). x e y dão a volta em 1.0, então lá a diferença é
+ * medida no toro: 0.99999 e 0.00001 estão a 2e-5 um do outro.
+ */
+static const float TOLERANCIA = 2e-5f;
+
+static float distanciaToro(float a, float b) {
+    float d = std::fabs(b - a);
+    d -= std::floor(d);
+    return std::min(d, 1.0f - d);
+}
+
+/*
+ * chama obterPosicoesEstrelas(tempo) sem buffer, o que faz o script criar e
+ * devolver uma table, e copia os valores para 'out'.
+ */
+static bool posicoesLua(lua_State* L, float tempo, std::vector<float>& out) {
+    lua_getglobal(L, "obterPosicoesEstrelas");
+    lua_pushnumber(L, tempo);
+    if (lua_pcall(L, 1, 1, 0) != LUA_OK) {
+        std::cerr << "paridade: " << lua_tostring(L, -1) << std::endl;
+        lua_pop(L, 1);
+        return false;
+    }
+    size_t n = lua_rawlen(L, -1);
+    out.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        lua_rawgeti(L, -1, (lua_Integer)i + 1);
+        out[i] = (float)lua_tonumber(L, -1);
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+    return true;
+}
+
+struct Motor {
+    const char*   caminho;
+    bool          paralelo;
+    CampoEstrelas campo;
+    float         erro[5];
+    int           falhas;
+    int           costuras;
+};
+
+/*
+ * compara uma estrela. Uma estrela cujo y derivado cai a ~1e-7 de 0 pode
+ * ficar em 0 no float e em 1 no double (ou o contrário). Como o wrap de y
+ * vem antes da rotação, a posição final muda de lugar; esses casos batem
+ * com o deslocamento de 1.0 em y já rotacionado (costuraX, costuraY) e são
+ * contados à parte, sem falhar.
+ */
+static void compararEstrela(Motor& m, float tempo, int estrela, const float* a, const float* b,
+                            float costuraX, float costuraY) {
+    float erro[5];
+    for (int c = 0; c < 5; ++c) erro[c] = std::fabs(b[c] - a[c]);
+    erro[0] = distanciaToro(a[0], b[0]);
+    erro[1] = distanciaToro(a[1], b[1]);
+    if ((erro[0] > TOLERANCIA || erro[1] > TOLERANCIA) &&
+        ((distanciaToro(a[0] + costuraX, b[0]) <= TOLERANCIA &&
+          distanciaToro(a[1] + costuraY, b[1]) <= TOLERANCIA) ||
+         (distanciaToro(a[0] - costuraX, b[0]) <= TOLERANCIA &&
+          distanciaToro(a[1] - costuraY, b[1]) <= TOLERANCIA))) {
+        ++m.costuras;
+        erro[0] = erro[1] = 0.0f;
+    }
+    for (int c = 0; c < 5; ++c) {
+        if (erro[c] > m.erro[c]) m.erro[c] = erro[c];
+        if (erro[c] > TOLERANCIA && m.falhas++ < 5) {
+            std::cerr << m.caminho << (m.paralelo ? "/pool" : "/serial") << ": t=" << tempo
+                      << " estrela " << estrela << " campo " << "xyrgb"[c] << ": lua " << a[c]
+                      << ", nativo " << b[c] << std::endl;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "uso: paridade_estrelas lua/background.lua [instantes] [estrelas]" << std::endl;
+        return 2;
+    }
+    int instantes = argc > 2 ? std::max(1, std::atoi(argv[2])) : 120;
+    int n         = std::max(argc > 3 ? std::atoi(argv[3]) : 0,
+                             CampoEstrelas::MINIMO_PARALELO + CampoEstrelas::TAMANHO_BLOCO / 2);
+
+    lua_State* L = luaL_newstate();
+    luaL_openlibs(L);
+    if (luaL_dofile(L, argv[1]) != LUA_OK) {
+        std::cerr << "paridade: " << lua_tostring(L, -1) << std::endl;
+        return 2;
+    }
+    lua_getglobal(L, "inicializarEstrelas");
+    lua_pushinteger(L, n);
+    if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
+        std::cerr << "paridade: " << lua_tostring(L, -1) << std::endl;
+        return 2;
+    }
+
+    std::vector<Motor> motores;
+    for (const char* caminho : CampoEstrelas::caminhosDisponiveis()) {
+        for (bool paralelo : {false, true}) {
+            motores.push_back({caminho, paralelo, CampoEstrelas(), {}, 0, 0});
+            Motor& m = motores.back();
+            m.campo.definirParalelo(paralelo);
+            m.campo.forcarCaminho(caminho);
+            m.campo.inicializar(n);
+        }
+    }
+
+    std::vector<float> esperado, obtido;
+    for (int i = 0; i < instantes; ++i) {
+        // passos irregulares para cobrir a rotação de 120 s e tempos longos
+        float tempo = i * 0.731f;
+        if (!posicoesLua(L, tempo, esperado)) return 2;
+        if (esperado.size() != (size_t)n * 5u) {
+            std::cerr << "paridade: o Lua devolveu " << esperado.size() / 5
+                      << " estrelas, esperado " << n << std::endl;
+            return 1;
+        }
+        // deslocamento de 1.0 em y antes da rotação, já rotacionado
+        double angulo = tempo * (2.0 * M_PI / 120.0);
+        float costuraX = (float)-std::sin(angulo), costuraY = (float)std::cos(angulo);
+        for (Motor& m : motores) {
+            m.campo.calcular(tempo, obtido);
+            for (int e = 0; e < n; ++e)
+                compararEstrela(m, tempo, e, &esperado[(size_t)e * 5u], &obtido[(size_t)e * 5u],
+                                costuraX, costuraY);
+        }
+    }
+    lua_close(L);
+
+    int falhas = 0;
+    std::printf("paridade: %d estrelas, %d instantes, tolerância %g\n", n, instantes, TOLERANCIA);
+    for (const Motor& m : motores) {
+        std::printf("  %-8s %-7s erro máx x %.2e y %.2e r %.2e g %.2e b %.2e  costura %d  %s\n",
+                    m.caminho, m.paralelo ? "pool" : "serial",
+                    m.erro[0], m.erro[1], m.erro[2], m.erro[3], m.erro[4], m.costuras, m.falhas ? "FALHOU" : "ok");
+        falhas += m.falhas;
+    }
+    return falhas ? 1 : 0;
+}